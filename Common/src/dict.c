@@ -0,0 +1,255 @@
+#define _DEFAULT_SOURCE /* MAP_POPULATE */
+
+#include "dict.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Where available the whole file is mapped up front, instead of taking a
+   page fault for every page touched */
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+/* Bytes per line assumed when sizing the entry array */
+#define DICT_LINE_ESTIMATE 64
+
+/* Splits the line [s, end) at its tabs, which become NULs (end must be
+   writable and is overwritten too). The first three fields are the
+   traditional, simplified and pinyin forms, the last one the
+   translation; missing fields are NULL. Returns 0 if the line has no
+   tab, so no key. */
+static int dict_parse_line(char* s, char* end, ChineseDictEntry* e) {
+  *end = '\0';
+  e->trad = e->simp = e->pinyin = NULL;
+  int index = 0;
+  char* tab;
+  while ((tab = memchr(s, '\t', end - s))) {
+    *tab = '\0';
+    index++;
+    if (index == 1)
+      e->trad = s;
+    else if (index == 2)
+      e->simp = s;
+    else if (index == 3)
+      e->pinyin = s;
+    s = tab + 1;
+  }
+  e->translation = s;
+  return index > 0;
+}
+
+/* Entries parsed from the lines in [begin, end) */
+typedef struct dict_batch {
+  pthread_t thread;
+  char* begin;
+  char* end;
+  ChineseDictEntry* entries;
+  size_t count;
+  char* tail; /* copy of a last line without newline, else NULL */
+  int failed;
+} dict_batch;
+
+/* Parses the batch's lines; returns 0 on success, -1 if memory ran out */
+static int dict_parse_chunk(dict_batch* b) {
+  char* p = b->begin;
+  char* end = b->end;
+  size_t cap = (end - p) / DICT_LINE_ESTIMATE + 16;
+  b->entries = malloc(cap * sizeof(ChineseDictEntry));
+  if (!b->entries)
+    return -1;
+
+  while (p < end) {
+    if (b->count == cap) {
+      cap *= 2;
+      ChineseDictEntry* e = realloc(b->entries, cap * sizeof(*e));
+      if (!e)
+        return -1;
+      b->entries = e;
+    }
+    char* nl = memchr(p, '\n', end - p);
+    if (!nl) {
+      /* No newline after the last line, and no room for its NUL in the
+         mapping: it gets a copy */
+      size_t len = end - p;
+      b->tail = malloc(len + 1);
+      if (!b->tail)
+        return -1;
+      memcpy(b->tail, p, len);
+      p = b->tail;
+      nl = p + len;
+      end = nl;
+    }
+    if (dict_parse_line(p, nl, &b->entries[b->count]))
+      b->count++;
+    p = nl + 1;
+  }
+  return 0;
+}
+
+static void* dict_parse_task(void* arg) {
+  dict_batch* b = arg;
+  b->failed = dict_parse_chunk(b) != 0;
+  return NULL;
+}
+
+/* Maps path, splits it into up to threads newline aligned chunks of at
+   least DICT_MIN_CHUNK bytes and parses them in parallel, chunk 0 on the
+   calling thread. The batches are then concatenated in file order. */
+static dict_file* dict_load_chunks(const char* path, size_t threads) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  dict_file* dict = calloc(1, sizeof(dict_file));
+  if (!dict) {
+    close(fd);
+    return NULL;
+  }
+  dict->map_size = (size_t)st.st_size;
+  if (dict->map_size == 0) {
+    close(fd);
+    return dict;
+  }
+  size_t t = dict->map_size / DICT_MIN_CHUNK;
+  if (t > threads)
+    t = threads;
+  if (t < 1)
+    t = 1;
+  /* Private and writable: the NULs written by the tokeniser stay in this
+     process' copy of the touched pages. A single parser gets the pages
+     populated up front, parallel ones fault their own chunks in. */
+  dict->map = mmap(NULL, dict->map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | (t == 1 ? MAP_POPULATE : 0), fd, 0);
+  close(fd);
+  if (dict->map == MAP_FAILED) {
+    free(dict);
+    return NULL;
+  }
+
+  dict_batch* batches = calloc(t, sizeof(dict_batch));
+  int* started = calloc(t, sizeof(int));
+  if (!batches || !started) {
+    free(batches);
+    free(started);
+    dict_free(dict);
+    return NULL;
+  }
+  char* end = dict->map + dict->map_size;
+  char* p = dict->map;
+  for (size_t i = 0; i < t; i++) {
+    batches[i].begin = p;
+    p = i + 1 < t ? dict->map + dict->map_size * (i + 1) / t : end;
+    if (p < batches[i].begin)
+      p = batches[i].begin;
+    if (p < end) {
+      char* nl = memchr(p, '\n', end - p);
+      p = nl ? nl + 1 : end;
+    }
+    batches[i].end = p;
+  }
+
+  for (size_t i = 1; i < t; i++)
+    started[i] = pthread_create(&batches[i].thread, NULL, dict_parse_task,
+                                &batches[i]) == 0;
+  dict_parse_task(&batches[0]);
+  size_t total = 0;
+  int failed = 0;
+  for (size_t i = 0; i < t; i++) {
+    if (i > 0 && started[i])
+      pthread_join(batches[i].thread, NULL);
+    else if (i > 0)
+      dict_parse_task(&batches[i]);
+    total += batches[i].count;
+    failed |= batches[i].failed;
+  }
+  free(started);
+
+  /* Merge: a single batch is taken over, several are copied in order */
+  if (!failed) {
+    dict->tail = batches[t - 1].tail;
+    batches[t - 1].tail = NULL;
+    dict->count = total;
+    if (t == 1) {
+      dict->entries = batches[0].entries;
+      batches[0].entries = NULL;
+    } else {
+      dict->entries = malloc((total ? total : 1) * sizeof(ChineseDictEntry));
+      failed = !dict->entries;
+      for (size_t i = 0, at = 0; !failed && i < t; i++) {
+        memcpy(&dict->entries[at], batches[i].entries,
+               batches[i].count * sizeof(ChineseDictEntry));
+        at += batches[i].count;
+      }
+    }
+  }
+  for (size_t i = 0; i < t; i++) {
+    free(batches[i].entries);
+    free(batches[i].tail);
+  }
+  free(batches);
+  if (failed) {
+    dict_free(dict);
+    return NULL;
+  }
+  return dict;
+}
+
+/* Maps path and builds one entry per line that has a tab. Returns NULL
+   if the file cannot be read or memory runs out. */
+dict_file* dict_load(const char* path) {
+  return dict_load_chunks(path, 1);
+}
+
+/* dict_load on up to the given number of threads (0: one per online CPU),
+   with the same entries in the same order */
+dict_file* dict_load_parallel(const char* path, const size_t threads) {
+  size_t t = threads;
+  if (t == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    t = cpus > 0 ? (size_t)cpus : 1;
+  }
+  return dict_load_chunks(path, t);
+}
+
+/* Replaces the key, simplified and pinyin fields with their canonical
+   pointers from pool, so equal fields (simplified forms that match the
+   traditional ones, repeated keys) share one pointer. Nothing is copied,
+   so the pool must not be used after dict_free. Returns -1 if memory runs
+   out. */
+int dict_intern(dict_file* dict, intern_pool* pool) {
+  for (size_t i = 0; i < dict->count; i++) {
+    ChineseDictEntry* e = &dict->entries[i];
+    char** fields[] = {&e->trad, &e->simp, &e->pinyin};
+    for (int f = 0; f < 3; f++) {
+      if (!*fields[f])
+        continue;
+      const char* s = intern_ref(pool, *fields[f]);
+      if (!s)
+        return -1;
+      /* Canonical pointers are fields of this or an earlier entry */
+      *fields[f] = (char*)s;
+    }
+  }
+  return 0;
+}
+
+void dict_free(dict_file* dict) {
+  if (!dict)
+    return;
+  if (dict->map)
+    munmap(dict->map, dict->map_size);
+  free(dict->tail);
+  free(dict->entries);
+  free(dict);
+}
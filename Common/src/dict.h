@@ -0,0 +1,37 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include <stddef.h>
+
+#include "intern.h"
+
+/* Bytes per thread below which dict_load_parallel uses fewer threads */
+#define DICT_MIN_CHUNK (1 << 20)
+
+/* One dictionary line: traditional, simplified, pinyin and translation,
+   separated by tabs */
+typedef struct {
+  char* trad;
+  char* simp;
+  char* pinyin;
+  char* translation;
+} ChineseDictEntry;
+
+/* A loaded HanDeDict/CC-CEDICT style file. The file is mapped privately
+   and tokenised in place, so the entries' fields point into the mapping
+   and stay valid until dict_free; there is no allocation per line. */
+typedef struct dict_file {
+  char* map;
+  size_t map_size;
+  char* tail; /* copy of a last line without newline, else NULL */
+  ChineseDictEntry* entries;
+  size_t count;
+} dict_file;
+
+/* API */
+dict_file* dict_load(const char* path);
+dict_file* dict_load_parallel(const char* path, const size_t threads);
+int dict_intern(dict_file* dict, intern_pool* pool);
+void dict_free(dict_file* dict);
+
+#endif
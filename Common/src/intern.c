@@ -0,0 +1,157 @@
+#include "intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Grow when the table would be more than 3/4 full */
+#define INTERN_LOAD_NUM 3
+#define INTERN_LOAD_DEN 4
+
+/* FNV-1a over the bytes, also returning the length */
+static size_t intern_hash(const char* s, size_t* len) {
+  const unsigned char* p = (const unsigned char*)s;
+  size_t h = (size_t)0xcbf29ce484222325ULL;
+  while (*p) {
+    h ^= *p++;
+    h *= (size_t)0x100000001b3ULL;
+  }
+  *len = (size_t)((const char*)p - s);
+  return h;
+}
+
+/* The slot holding s, or the empty slot where it would go */
+static intern_slot* intern_probe(const intern_pool* pool,
+                                 const char* s,
+                                 const size_t hash) {
+  size_t mask = pool->capacity - 1;
+  size_t i = hash & mask;
+  for (;;) {
+    intern_slot* slot = &pool->slots[i];
+    if (!slot->str ||
+        (slot->hash == hash && (slot->str == s || strcmp(slot->str, s) == 0)))
+      return slot;
+    i = (i + 1) & mask;
+  }
+}
+
+static int intern_grow(intern_pool* pool) {
+  size_t capacity = pool->capacity * 2;
+  intern_slot* slots = calloc(capacity, sizeof(intern_slot));
+  if (!slots)
+    return -1;
+  for (size_t i = 0; i < pool->capacity; i++) {
+    intern_slot* old = &pool->slots[i];
+    if (!old->str)
+      continue;
+    size_t j = old->hash & (capacity - 1);
+    while (slots[j].str)
+      j = (j + 1) & (capacity - 1);
+    slots[j] = *old;
+  }
+  free(pool->slots);
+  pool->slots = slots;
+  pool->capacity = capacity;
+  return 0;
+}
+
+/* Copies len bytes and a NUL into the arena */
+static char* intern_copy(intern_pool* pool, const char* s, const size_t len) {
+  if ((size_t)(pool->bump_end - pool->bump) < len + 1) {
+    size_t size = len + 1 > INTERN_ARENA_SIZE ? len + 1 : INTERN_ARENA_SIZE;
+    intern_arena* a = malloc(sizeof(intern_arena) + size);
+    if (!a)
+      return NULL;
+    a->next = pool->arenas;
+    pool->arenas = a;
+    pool->bump = (char*)(a + 1);
+    pool->bump_end = pool->bump + size;
+  }
+  char* p = pool->bump;
+  memcpy(p, s, len + 1);
+  pool->bump += len + 1;
+  pool->bytes += len + 1;
+  return p;
+}
+
+/* Looks s up and, if it is new, adds it: copied into the arena, or the
+   caller's pointer itself if copy is 0 */
+static const char* intern_add(intern_pool* pool,
+                              const char* s,
+                              const int copy) {
+  if (!s)
+    return NULL;
+  size_t len;
+  size_t hash = intern_hash(s, &len);
+  intern_slot* slot = intern_probe(pool, s, hash);
+  if (slot->str)
+    return slot->str;
+
+  if ((pool->count + 1) * INTERN_LOAD_DEN >
+      pool->capacity * INTERN_LOAD_NUM) {
+    if (intern_grow(pool) != 0)
+      return NULL;
+    slot = intern_probe(pool, s, hash);
+  }
+  const char* str = copy ? intern_copy(pool, s, len) : s;
+  if (!str)
+    return NULL;
+  slot->hash = hash;
+  slot->str = str;
+  pool->count++;
+  return str;
+}
+
+intern_pool* intern_create(const size_t capacity) {
+  intern_pool* pool = malloc(sizeof(intern_pool));
+  if (!pool)
+    return NULL;
+  size_t cap = 16;
+  size_t want = capacity == 0 ? INTERN_DEFAULT_CAPACITY : capacity;
+  while (cap < want)
+    cap *= 2;
+  pool->slots = calloc(cap, sizeof(intern_slot));
+  if (!pool->slots) {
+    free(pool);
+    return NULL;
+  }
+  pool->capacity = cap;
+  pool->count = 0;
+  pool->arenas = NULL;
+  pool->bump = pool->bump_end = NULL;
+  pool->bytes = 0;
+  return pool;
+}
+
+void intern_destroy(intern_pool* pool) {
+  if (!pool)
+    return;
+  intern_arena* a = pool->arenas;
+  while (a) {
+    intern_arena* next = a->next;
+    free(a);
+    a = next;
+  }
+  free(pool->slots);
+  free(pool);
+}
+
+/* Canonical copy of s, made on first sight; NULL if memory runs out */
+const char* intern_str(intern_pool* pool, const char* s) {
+  return intern_add(pool, s, 1);
+}
+
+/* Like intern_str, but a new string is not copied: s itself becomes the
+   canonical pointer and must outlive the pool */
+const char* intern_ref(intern_pool* pool, const char* s) {
+  return intern_add(pool, s, 0);
+}
+
+/* Canonical pointer of s, NULL if it was never interned */
+const char* intern_find(const intern_pool* pool, const char* s) {
+  size_t len;
+  return intern_probe(pool, s, intern_hash(s, &len))->str;
+}
+
+size_t intern_count(const intern_pool* pool) {
+  return pool->count;
+}
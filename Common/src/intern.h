@@ -0,0 +1,45 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+/* Bytes per arena block; longer strings get a block of their own */
+#define INTERN_ARENA_SIZE (64 * 1024)
+
+/* Slots allocated unless the caller asks otherwise */
+#define INTERN_DEFAULT_CAPACITY 1024
+
+/* Block of interned bytes, strings follow the header back to back */
+typedef struct intern_arena {
+  struct intern_arena* next;
+} intern_arena;
+
+typedef struct intern_slot {
+  size_t hash;
+  const char* str; /* canonical copy, NULL if the slot is empty */
+} intern_slot;
+
+/* String intern pool. Every distinct string has one canonical pointer,
+   so interned strings are equal exactly when their pointers are. The
+   strings are found through an open addressing table (linear probing,
+   power of two capacity) and copied into arena blocks that are only
+   released in bulk by intern_destroy. */
+typedef struct intern_pool {
+  intern_slot* slots;
+  size_t capacity;
+  size_t count;
+  intern_arena* arenas; /* all blocks, newest first */
+  char* bump;           /* free space in the newest block */
+  char* bump_end;
+  size_t bytes; /* string bytes copied into the arenas */
+} intern_pool;
+
+/* API */
+intern_pool* intern_create(const size_t capacity);
+void intern_destroy(intern_pool* pool);
+const char* intern_str(intern_pool* pool, const char* s);
+const char* intern_ref(intern_pool* pool, const char* s);
+const char* intern_find(const intern_pool* pool, const char* s);
+size_t intern_count(const intern_pool* pool);
+
+#endif
@@ -0,0 +1,65 @@
+#include "slab.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+
+/* Slab header is padded so objects keep malloc alignment */
+#define SLAB_HEADER_SIZE \
+  ((sizeof(slab) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+slab_pool* slab_create(const size_t obj_size, const size_t objs_per_slab) {
+  slab_pool* pool = malloc(sizeof(slab_pool));
+  if (!pool)
+    return NULL;
+  /* Objects must hold the free list link and stay aligned */
+  size_t size = obj_size < sizeof(void*) ? sizeof(void*) : obj_size;
+  size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+  pool->obj_size = size;
+  pool->objs_per_slab =
+      objs_per_slab == 0 ? SLAB_DEFAULT_OBJECTS : objs_per_slab;
+  pool->slabs = NULL;
+  pool->bump = pool->bump_end = NULL;
+  pool->free_list = NULL;
+  pool->slab_count = 0;
+  return pool;
+}
+
+void slab_destroy(slab_pool* pool) {
+  if (!pool)
+    return;
+  slab* s = pool->slabs;
+  while (s) {
+    slab* next = s->next;
+    free(s);
+    s = next;
+  }
+  free(pool);
+}
+
+void* slab_alloc(slab_pool* pool) {
+  if (pool->free_list) {
+    void* p = pool->free_list;
+    pool->free_list = *(void**)p;
+    return p;
+  }
+  if (pool->bump == pool->bump_end) {
+    slab* s = malloc(SLAB_HEADER_SIZE + pool->obj_size * pool->objs_per_slab);
+    if (!s)
+      return NULL;
+    s->next = pool->slabs;
+    pool->slabs = s;
+    pool->slab_count++;
+    pool->bump = (char*)s + SLAB_HEADER_SIZE;
+    pool->bump_end = pool->bump + pool->obj_size * pool->objs_per_slab;
+  }
+  void* p = pool->bump;
+  pool->bump += pool->obj_size;
+  return p;
+}
+
+void slab_free(slab_pool* pool, void* ptr) {
+  if (!ptr)
+    return;
+  *(void**)ptr = pool->free_list;
+  pool->free_list = ptr;
+}
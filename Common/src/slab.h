@@ -0,0 +1,32 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+/* Objects carved from each slab unless the caller asks otherwise */
+#define SLAB_DEFAULT_OBJECTS 256
+
+/* Fixed size object pool. Objects are carved from large slabs and freed
+   objects are kept on a free list; memory is only returned to the system
+   in bulk by slab_destroy. */
+typedef struct slab {
+  struct slab* next;
+} slab;
+
+typedef struct slab_pool {
+  size_t obj_size;
+  size_t objs_per_slab;
+  slab* slabs; /* all slabs, newest first */
+  char* bump;  /* next never used object in the newest slab */
+  char* bump_end;
+  void* free_list; /* freed objects, linked through their first word */
+  size_t slab_count;
+} slab_pool;
+
+/* API */
+slab_pool* slab_create(const size_t obj_size, const size_t objs_per_slab);
+void slab_destroy(slab_pool* pool);
+void* slab_alloc(slab_pool* pool);
+void slab_free(slab_pool* pool, void* ptr);
+
+#endif
@@ -0,0 +1,571 @@
+#define _DEFAULT_SOURCE /* syscall, getline, mkstemp */
+
+#include "suite.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "dict.h"
+
+/* Bytes per generated key, NUL included */
+#define SUITE_KEY_SLOT 24
+
+static const char* suite_workloads = SUITE_WORKLOADS;
+static const char* suite_label = NULL;
+static int suite_counting = 0;
+static double suite_start;
+
+/* Hardware counters, each opened on its own so one the CPU lacks does not
+   take the others with it; fd is -1 for unavailable ones */
+typedef struct suite_counter {
+  const char* name;
+  uint32_t type;
+  uint64_t config;
+  int fd;
+  double value; /* per operation in the last workload, < 0 if unknown */
+} suite_counter;
+
+#ifdef __linux__
+#define SUITE_CACHE(cache, result)                                    \
+  ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | ((result) << 16))
+
+static suite_counter suite_counters[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, -1},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, -1},
+    {"l1d_misses", PERF_TYPE_HW_CACHE,
+     SUITE_CACHE(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS), -1,
+     -1},
+    {"llc_misses", PERF_TYPE_HW_CACHE,
+     SUITE_CACHE(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS), -1,
+     -1},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, -1},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE,
+     SUITE_CACHE(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS),
+     -1, -1},
+};
+#else
+static suite_counter suite_counters[] = {
+    {"cycles", 0, 0, -1, -1},        {"instructions", 0, 0, -1, -1},
+    {"l1d_misses", 0, 0, -1, -1},    {"llc_misses", 0, 0, -1, -1},
+    {"branch_misses", 0, 0, -1, -1}, {"dtlb_misses", 0, 0, -1, -1},
+};
+#endif
+
+#define SUITE_COUNTERS (sizeof(suite_counters) / sizeof(suite_counters[0]))
+
+/* ---------- Helpers ---------- */
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+int suite_str_cmp(const void* a, const void* b) {
+  if (a == b)
+    return 0;
+  return strcmp((const char*)a, (const char*)b);
+}
+
+static int qsort_str_cmp(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* Whether name is an element of the comma separated list */
+static int in_list(const char* list, const char* name) {
+  size_t len = strlen(name);
+  for (const char* p = list; p && *p;) {
+    const char* comma = strchr(p, ',');
+    size_t n = comma ? (size_t)(comma - p) : strlen(p);
+    if (n == len && strncmp(p, name, len) == 0)
+      return 1;
+    p = comma ? comma + 1 : NULL;
+  }
+  return 0;
+}
+
+int suite_enabled(const char* workload) {
+  return in_list(suite_workloads, workload);
+}
+
+/* Peak RSS in KiB since the last reset. Linux resets the high water mark
+   through clear_refs; elsewhere it is the peak of the whole process. */
+static void reset_peak_rss(void) {
+  FILE* fp = fopen("/proc/self/clear_refs", "w");
+  if (fp) {
+    fputs("5", fp);
+    fclose(fp);
+  }
+}
+
+static long peak_rss_kb(void) {
+  FILE* fp = fopen("/proc/self/status", "r");
+  if (fp) {
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), fp))
+      if (sscanf(line, "VmHWM: %ld kB", &kb) == 1)
+        break;
+    fclose(fp);
+    if (kb >= 0)
+      return kb;
+  }
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+}
+
+/* Opens the counters for this thread, user space only. Returns how many
+   are available; the rest are reported as null. */
+static size_t counters_open(void) {
+  size_t open = 0;
+#ifdef __linux__
+  for (size_t i = 0; i < SUITE_COUNTERS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = suite_counters[i].type;
+    attr.config = suite_counters[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    suite_counters[i].fd =
+        (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    open += suite_counters[i].fd >= 0;
+  }
+#endif
+  return open;
+}
+
+static void counters_start(void) {
+#ifdef __linux__
+  for (size_t i = 0; i < SUITE_COUNTERS; i++) {
+    if (suite_counters[i].fd < 0)
+      continue;
+    ioctl(suite_counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(suite_counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+/* Stops the counters and keeps their values per operation. Counts are
+   scaled up when the kernel had to multiplex them. */
+static void counters_stop(const size_t ops) {
+  for (size_t i = 0; i < SUITE_COUNTERS; i++) {
+    suite_counter* c = &suite_counters[i];
+    c->value = -1;
+#ifdef __linux__
+    uint64_t r[3]; /* value, time enabled, time running */
+    if (c->fd < 0)
+      continue;
+    ioctl(c->fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(c->fd, r, sizeof(r)) != (ssize_t)sizeof(r) || r[2] == 0)
+      continue;
+    double count = (double)r[0];
+    if (r[2] < r[1])
+      count *= (double)r[1] / (double)r[2];
+    c->value = ops ? count / (double)ops : count;
+#else
+    (void)ops; /* unused */
+#endif
+  }
+}
+
+/* String as a JSON string literal */
+static void print_json_str(const char* s) {
+  putchar('"');
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\')
+      printf("\\%c", c);
+    else if (c < 0x20)
+      printf("\\u%04x", c);
+    else
+      putchar(c);
+  }
+  putchar('"');
+}
+
+void suite_begin(void) {
+  reset_peak_rss();
+  if (suite_counting)
+    counters_start();
+  suite_start = now_ns();
+}
+
+/* Ends the workload started by suite_begin and prints its result as one
+   line of JSON */
+void suite_end(const suite_keys* keys,
+               const char* workload,
+               const size_t ops) {
+  double ns = now_ns() - suite_start;
+  if (suite_counting)
+    counters_stop(ops);
+  long rss = peak_rss_kb();
+  if (ns <= 0)
+    ns = 1;
+
+  printf("{\"container\":");
+  print_json_str(suite_container);
+  printf(",\"workload\":");
+  print_json_str(workload);
+  printf(",\"keys\":");
+  print_json_str(keys->name);
+  if (suite_label) {
+    printf(",\"label\":");
+    print_json_str(suite_label);
+  }
+  printf(
+      ",\"n\":%zu,\"ops\":%zu,\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f,"
+      "\"total_ms\":%.3f,\"peak_rss_kb\":%ld",
+      keys->n, ops, ops ? ns / (double)ops : 0.0,
+      (double)ops * 1e9 / ns, ns / 1e6, rss);
+  if (suite_counting) {
+    /* Per operation, null where the counter is unavailable */
+    printf(",\"counters\":{");
+    for (size_t i = 0; i < SUITE_COUNTERS; i++) {
+      const suite_counter* c = &suite_counters[i];
+      printf(i ? ",\"%s\":" : "\"%s\":", c->name);
+      if (c->value < 0)
+        printf("null");
+      else
+        printf("%.3f", c->value);
+    }
+    putchar('}');
+  }
+  printf("}\n");
+  fflush(stdout);
+}
+
+/* ---------- Key sets ---------- */
+
+/* n distinct random looking keys of equal length, and as many misses,
+   stored in one block */
+static char* make_synthetic(suite_keys* keys, const size_t n) {
+  char* block = malloc(2 * n * SUITE_KEY_SLOT);
+  keys->random = malloc(n * sizeof(char*));
+  keys->sorted = malloc(n * sizeof(char*));
+  keys->misses = malloc(n * sizeof(char*));
+  if (!block || !keys->random || !keys->sorted || !keys->misses) {
+    fprintf(stderr, "Failed to allocate %zu keys\n", n);
+    abort();
+  }
+  for (size_t i = 0; i < n; i++) {
+    unsigned long long r = splitmix64(i);
+    keys->random[i] = block + 2 * i * SUITE_KEY_SLOT;
+    keys->misses[i] = keys->random[i] + SUITE_KEY_SLOT;
+    snprintf(keys->random[i], SUITE_KEY_SLOT, "key-%016llx", r);
+    snprintf(keys->misses[i], SUITE_KEY_SLOT, "miss-%016llx", r);
+  }
+  keys->name = "synthetic";
+  keys->n = n;
+  memcpy(keys->sorted, keys->random, n * sizeof(char*));
+  qsort(keys->sorted, n, sizeof(char*), qsort_str_cmp);
+  return block;
+}
+
+/* The dictionary keys (first fields, repeats included) shuffled, and each
+   key with '#' appended as a miss */
+static char* make_handedict(suite_keys* keys, dict_file* dict) {
+  size_t n = dict->count;
+  size_t bytes = 0;
+  for (size_t i = 0; i < n; i++)
+    bytes += strlen(dict->entries[i].trad) + 2;
+  char* block = malloc(bytes ? bytes : 1);
+  keys->random = malloc((n ? n : 1) * sizeof(char*));
+  keys->sorted = malloc((n ? n : 1) * sizeof(char*));
+  keys->misses = malloc((n ? n : 1) * sizeof(char*));
+  if (!block || !keys->random || !keys->sorted || !keys->misses) {
+    fprintf(stderr, "Failed to allocate %zu keys\n", n);
+    abort();
+  }
+  char* p = block;
+  for (size_t i = 0; i < n; i++) {
+    size_t len = strlen(dict->entries[i].trad);
+    keys->random[i] = dict->entries[i].trad;
+    keys->misses[i] = p;
+    memcpy(p, dict->entries[i].trad, len);
+    p[len] = '#';
+    p[len + 1] = '\0';
+    p += len + 2;
+  }
+  for (size_t i = n; i > 1; i--) {
+    size_t j = splitmix64(i) % i;
+    char* swap = keys->random[i - 1];
+    keys->random[i - 1] = keys->random[j];
+    keys->random[j] = swap;
+  }
+  keys->name = "handedict";
+  keys->n = n;
+  memcpy(keys->sorted, keys->random, n * sizeof(char*));
+  qsort(keys->sorted, n, sizeof(char*), qsort_str_cmp);
+  return block;
+}
+
+static void free_keys(suite_keys* keys, char* block) {
+  free(keys->random);
+  free(keys->sorted);
+  free(keys->misses);
+  free(block);
+}
+
+/* ---------- Load ---------- */
+
+static char* dup_str(const char* s) {
+  size_t len = strlen(s) + 1;
+  char* p = malloc(len);
+  if (!p) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  memcpy(p, s, len);
+  return p;
+}
+
+/* The dictionary written SUITE_LOAD_REPEAT times into a temporary file;
+   NULL if the dictionary cannot be read */
+static char* make_load_file(const char* dict_path) {
+  FILE* in = fopen(dict_path, "rb");
+  if (!in)
+    return NULL;
+  fseek(in, 0, SEEK_END);
+  long size = ftell(in);
+  rewind(in);
+  char* buf = malloc(size > 0 ? (size_t)size : 1);
+  size_t got = buf ? fread(buf, 1, size > 0 ? (size_t)size : 0, in) : 0;
+  fclose(in);
+
+  char* path = dup_str("/tmp/suite-dict-XXXXXX");
+  int fd = mkstemp(path);
+  FILE* out = fd >= 0 ? fdopen(fd, "wb") : NULL;
+  if (!buf || !out) {
+    fprintf(stderr, "Failed to create %s\n", path);
+    abort();
+  }
+  for (int i = 0; i < SUITE_LOAD_REPEAT; i++)
+    fwrite(buf, 1, got, out);
+  fclose(out);
+  free(buf);
+  return path;
+}
+
+/* The loop the demos had before dict_load: getline, then a copy of every
+   field of each line with a tab. Returns the entries and their count. */
+static ChineseDictEntry* load_getline(const char* path, size_t* count) {
+  FILE* fp = fopen(path, "r");
+  size_t cap = 1024;
+  ChineseDictEntry* entries = malloc(cap * sizeof(ChineseDictEntry));
+  if (!fp || !entries) {
+    fprintf(stderr, "Failed to load %s\n", path);
+    abort();
+  }
+  char* line = NULL;
+  size_t len = 0;
+  *count = 0;
+  while (getline(&line, &len, fp) != -1) {
+    line[strcspn(line, "\n")] = '\0';
+    if (!strchr(line, '\t'))
+      continue;
+    if (*count == cap) {
+      cap *= 2;
+      entries = realloc(entries, cap * sizeof(ChineseDictEntry));
+      if (!entries) {
+        fprintf(stderr, "Out of memory\n");
+        abort();
+      }
+    }
+    ChineseDictEntry* d = &entries[(*count)++];
+    d->trad = d->simp = d->pinyin = NULL;
+    char* field = line;
+    char* tab;
+    int index = 0;
+    while ((tab = strchr(field, '\t'))) {
+      *tab = '\0';
+      index++;
+      if (index == 1)
+        d->trad = dup_str(field);
+      else if (index == 2)
+        d->simp = dup_str(field);
+      else if (index == 3)
+        d->pinyin = dup_str(field);
+      field = tab + 1;
+    }
+    d->translation = dup_str(field);
+  }
+  free(line);
+  fclose(fp);
+  return entries;
+}
+
+static void free_getline(ChineseDictEntry* entries, const size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    free(entries[i].trad);
+    free(entries[i].simp);
+    free(entries[i].pinyin);
+    free(entries[i].translation);
+  }
+  free(entries);
+}
+
+/* Startup of the dictionary demos: file to filled container, with the
+   getline loop, dict_load and dict_load_parallel on one thread per CPU.
+   Each is counted per dictionary line; teardown is not timed. */
+static void run_load(const char* dict_path) {
+  if (!suite_enabled("load_getline") && !suite_enabled("load_dict") &&
+      !suite_enabled("load_parallel"))
+    return;
+  char* path = make_load_file(dict_path);
+  if (!path)
+    return;
+  suite_keys keys = {"handedict", 0, NULL, NULL, NULL};
+  size_t expected = 0;
+
+  if (suite_enabled("load_getline")) {
+    size_t count;
+    suite_begin();
+    ChineseDictEntry* entries = load_getline(path, &count);
+    void* container = suite_fill_dict(entries, count);
+    keys.n = count;
+    suite_end(&keys, "load_getline", count);
+    suite_free_dict(container);
+    free_getline(entries, count);
+    expected = count;
+  }
+
+  for (int parallel = 0; parallel <= 1; parallel++) {
+    const char* name = parallel ? "load_parallel" : "load_dict";
+    if (!suite_enabled(name))
+      continue;
+    suite_begin();
+    dict_file* dict = parallel ? dict_load_parallel(path, 0) : dict_load(path);
+    if (!dict) {
+      fprintf(stderr, "Failed to load %s\n", path);
+      abort();
+    }
+    void* container = suite_fill_dict(dict->entries, dict->count);
+    keys.n = dict->count;
+    suite_end(&keys, name, dict->count);
+    if (expected && dict->count != expected)
+      fprintf(stderr, "%s: %zu entries, expected %zu\n", name, dict->count,
+              expected);
+    expected = dict->count;
+    suite_free_dict(container);
+    dict_free(dict);
+  }
+
+  unlink(path);
+  free(path);
+}
+
+/* ---------- Driver ---------- */
+
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s [--sizes N,...] [--workloads W,...] [--keys K,...]\n"
+          "          [--dict PATH] [--label TEXT] [--counters]\n"
+          "Workloads: %s\n"
+          "Keys: synthetic,handedict\n"
+          "Prints one JSON object per workload and key set; --counters\n"
+          "adds hardware counters per operation where perf_event_open\n"
+          "allows it.\n",
+          prog, SUITE_WORKLOADS);
+}
+
+int main(int argc, char** argv) {
+  const char* sizes_arg = SUITE_DEFAULT_SIZES;
+  const char* keys_arg = "synthetic,handedict";
+  const char* dict_path = suite_dict_path;
+  for (int i = 1; i < argc; i++) {
+    const char* opt = argv[i];
+    if (strcmp(opt, "--counters") == 0) {
+      suite_counting = 1;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    if (strcmp(opt, "--sizes") == 0)
+      sizes_arg = argv[++i];
+    else if (strcmp(opt, "--workloads") == 0)
+      suite_workloads = argv[++i];
+    else if (strcmp(opt, "--keys") == 0)
+      keys_arg = argv[++i];
+    else if (strcmp(opt, "--dict") == 0)
+      dict_path = argv[++i];
+    else if (strcmp(opt, "--label") == 0)
+      suite_label = argv[++i];
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  size_t sizes[SUITE_MAX_SIZES];
+  size_t size_count = 0;
+  for (const char* p = sizes_arg; *p && size_count < SUITE_MAX_SIZES;) {
+    char* end;
+    size_t n = strtoul(p, &end, 10);
+    if (end == p || n == 0) {
+      usage(argv[0]);
+      return 1;
+    }
+    sizes[size_count++] = n;
+    p = *end == ',' ? end + 1 : end;
+  }
+
+  if (suite_counting) {
+    size_t open = counters_open();
+    if (open < SUITE_COUNTERS) {
+      fprintf(stderr, "%zu of %zu hardware counters available:", open,
+              SUITE_COUNTERS);
+      for (size_t i = 0; i < SUITE_COUNTERS; i++)
+        if (suite_counters[i].fd < 0)
+          fprintf(stderr, " %s", suite_counters[i].name);
+      fprintf(stderr, " reported as null\n");
+    }
+  }
+
+  suite_keys keys;
+  if (in_list(keys_arg, "synthetic")) {
+    for (size_t s = 0; s < size_count; s++) {
+      char* block = make_synthetic(&keys, sizes[s]);
+      suite_run(&keys);
+      free_keys(&keys, block);
+    }
+  }
+  if (in_list(keys_arg, "handedict")) {
+    dict_file* dict = dict_load(dict_path);
+    if (dict) {
+      char* block = make_handedict(&keys, dict);
+      suite_run(&keys);
+      free_keys(&keys, block);
+      dict_free(dict);
+      run_load(dict_path);
+    } else {
+      fprintf(stderr, "%s not found, skipping the handedict keys\n",
+              dict_path);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef SUITE_H
+#define SUITE_H
+
+#include <stddef.h>
+
+#include "dict.h"
+
+#define SUITE_MAX_SIZES 16
+
+/* Sizes run unless --sizes is given; up to 10000000 on request */
+#define SUITE_DEFAULT_SIZES "1000,10000,100000,1000000"
+
+/* Workloads, in the order they are run */
+#define SUITE_WORKLOADS                                                      \
+  "insert_random,insert_sequential,get_hit,get_miss,iterate,sort,remove,"    \
+  "load_getline,load_dict,load_parallel"
+
+/* Times the dictionary is repeated in the file the load workloads read,
+   so that dict_load_parallel has more than one chunk to split */
+#define SUITE_LOAD_REPEAT 8
+
+/* Keys of one run: the same n keys in random and in ascending strcmp
+   order, and n keys that are never inserted */
+typedef struct suite_keys {
+  const char* name; /* "synthetic" or "handedict" */
+  size_t n;
+  char** random;
+  char** sorted;
+  char** misses;
+} suite_keys;
+
+/* Provided by each container's suite */
+extern const char* const suite_container;
+extern const char* const suite_dict_path;
+void suite_run(const suite_keys* keys);
+/* The container a demo fills from loaded dictionary entries, keyed by
+   their first field, and its teardown */
+void* suite_fill_dict(ChineseDictEntry* entries, const size_t n);
+void suite_free_dict(void* container);
+
+/* Harness */
+int suite_str_cmp(const void* a, const void* b);
+int suite_enabled(const char* workload);
+void suite_begin(void);
+void suite_end(const suite_keys* keys,
+               const char* workload,
+               const size_t ops);
+int main(int argc, char** argv);
+
+#endif
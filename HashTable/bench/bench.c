@@ -0,0 +1,516 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "dict.h"
+#include "hashtable.h"
+#include "hashtable_oa.h"
+
+#define BENCH_HOT_KEYS 1024
+#define BENCH_HOT_OPS 10000000
+#define BENCH_BATCH 256
+#define BENCH_DICT_PATH "data/handedict.txt"
+#define BENCH_DICT_ROUNDS 20
+
+/* ---------- Helpers ---------- */
+
+double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/* djb2, the same weak hash the demo uses */
+size_t str_hash(const void* key) {
+  const char* s = key;
+  size_t h = 5381;
+  while (*s)
+    h = ((h << 5) + h) + (unsigned char)*s++;
+  return h;
+}
+
+int str_eq(const void* a, const void* b) {
+  if (a == b)
+    return 1;
+  return strcmp((const char*)a, (const char*)b) == 0;
+}
+
+/* Random looking keys, so the benchmark does not profit from djb2 mapping
+   sequential keys to neighbouring buckets */
+char** make_keys(const size_t n, const char* prefix) {
+  char** keys = malloc(n * sizeof(char*));
+  char buf[64];
+  for (size_t i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "%s%016llx", prefix,
+             (unsigned long long)splitmix64(i));
+    keys[i] = malloc(strlen(buf) + 1);
+    strcpy(keys[i], buf);
+  }
+  return keys;
+}
+
+void free_keys(char** keys, const size_t n) {
+  for (size_t i = 0; i < n; i++)
+    free(keys[i]);
+  free(keys);
+}
+
+void shuffle(char** keys, const size_t n) {
+  srand(42);
+  for (size_t i = n; i > 1; i--) {
+    size_t j = ((size_t)rand() * ((size_t)RAND_MAX + 1) + (size_t)rand()) % i;
+    char* t = keys[i - 1];
+    keys[i - 1] = keys[j];
+    keys[j] = t;
+  }
+}
+
+void report(const char* name, const size_t ops, const double ns) {
+  printf("%-28s %10zu ops %10.1f ns/op\n", name, ops, ns / (double)ops);
+}
+
+int cmp_double(const void* a, const void* b) {
+  double da = *(const double*)a;
+  double db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+/* Sorts the per-operation latencies and prints the tail percentiles */
+void report_latency(const char* name, double* lat, const size_t n) {
+  qsort(lat, n, sizeof(double), cmp_double);
+  printf("%-28s p50 %8.0f  p99 %8.0f  p999 %8.0f  max %10.0f ns\n", name,
+         lat[n / 2], lat[n * 99 / 100], lat[n * 999 / 1000], lat[n - 1]);
+}
+
+/* ---------- Baseline table ---------- */
+
+/* Chained table as it was before entries cached their hash, kept as a
+   baseline for the comparisons below. A resize calls the user hash for
+   every entry and a lookup calls key_eq on every entry of the chain.
+   Indexing is ht_mix and a mask as in hash_table, or with modulo set the
+   raw user hash modulo the capacity, as before the mask. */
+typedef struct base_entry {
+  void* key;
+  void* value;
+  struct base_entry* next;
+} base_entry;
+
+typedef struct base_table {
+  size_t capacity;
+  size_t size;
+  base_entry** buckets;
+  int modulo;
+  hash_func hash;
+  key_eq_func key_eq;
+} base_table;
+
+static size_t base_index(const base_table* bt,
+                         const void* key,
+                         const size_t capacity) {
+  if (bt->modulo)
+    return bt->hash(key) % capacity;
+  return ht_mix(bt->hash(key)) & (capacity - 1);
+}
+
+static base_table* base_create(hash_func hash,
+                               key_eq_func key_eq,
+                               const int modulo) {
+  base_table* bt = malloc(sizeof(base_table));
+  if (!bt)
+    return NULL;
+  bt->capacity = HT_INITIAL_CAPACITY;
+  bt->size = 0;
+  bt->modulo = modulo;
+  bt->hash = hash;
+  bt->key_eq = key_eq;
+  bt->buckets = calloc(bt->capacity, sizeof(base_entry*));
+  if (!bt->buckets) {
+    free(bt);
+    return NULL;
+  }
+  return bt;
+}
+
+static void base_destroy(base_table* bt) {
+  for (size_t i = 0; i < bt->capacity; i++) {
+    base_entry* e = bt->buckets[i];
+    while (e) {
+      base_entry* next = e->next;
+      free(e);
+      e = next;
+    }
+  }
+  free(bt->buckets);
+  free(bt);
+}
+
+static int base_resize(base_table* bt, const size_t new_capacity) {
+  base_entry** new_buckets = calloc(new_capacity, sizeof(base_entry*));
+  if (!new_buckets)
+    return -1;
+  for (size_t i = 0; i < bt->capacity; i++) {
+    base_entry* e = bt->buckets[i];
+    while (e) {
+      base_entry* next = e->next;
+      size_t idx = base_index(bt, e->key, new_capacity);
+      e->next = new_buckets[idx];
+      new_buckets[idx] = e;
+      e = next;
+    }
+  }
+  free(bt->buckets);
+  bt->buckets = new_buckets;
+  bt->capacity = new_capacity;
+  return 0;
+}
+
+static int base_insert(base_table* bt, void* key, void* value) {
+  if ((double)bt->size / bt->capacity > HT_MAX_LOAD_FACTOR)
+    if (base_resize(bt, bt->capacity * 2) != 0)
+      return -1;
+  size_t idx = base_index(bt, key, bt->capacity);
+  for (base_entry* e = bt->buckets[idx]; e; e = e->next) {
+    if (bt->key_eq(e->key, key)) {
+      e->value = value;
+      return 0;
+    }
+  }
+  base_entry* e = malloc(sizeof(base_entry));
+  if (!e)
+    return -1;
+  e->key = key;
+  e->value = value;
+  e->next = bt->buckets[idx];
+  bt->buckets[idx] = e;
+  bt->size++;
+  return 0;
+}
+
+static void* base_get(const base_table* bt, const void* key) {
+  size_t idx = base_index(bt, key, bt->capacity);
+  for (base_entry* e = bt->buckets[idx]; e; e = e->next)
+    if (bt->key_eq(e->key, key))
+      return e->value;
+  return NULL;
+}
+
+static int base_remove(base_table* bt, const void* key) {
+  base_entry** link = &bt->buckets[base_index(bt, key, bt->capacity)];
+  for (base_entry* e = *link; e; link = &e->next, e = e->next) {
+    if (bt->key_eq(e->key, key)) {
+      *link = e->next;
+      free(e);
+      bt->size--;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* ---------- Workloads ---------- */
+
+void bench_chained(char** keys, char** misses, const size_t n) {
+  size_t found = 0;
+  hash_table* ht = ht_create(0, str_hash, str_eq, NULL, NULL);
+  if (!ht) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+
+  double t = now_ns();
+  for (size_t i = 0; i < n; i++)
+    ht_insert(ht, keys[i], keys[i]);
+  report("ht_insert", n, now_ns() - t);
+
+  shuffle(keys, n);
+  t = now_ns();
+  for (size_t i = 0; i < n; i++)
+    found += ht_get(ht, keys[i]) != NULL;
+  report("ht_get (hit)", n, now_ns() - t);
+
+  t = now_ns();
+  for (size_t i = 0; i < n; i++)
+    found += ht_get(ht, misses[i]) != NULL;
+  report("ht_get (miss)", n, now_ns() - t);
+
+  /* Cache resident lookups, dominated by hashing and indexing */
+  size_t hot = n < BENCH_HOT_KEYS ? n : BENCH_HOT_KEYS;
+  t = now_ns();
+  for (size_t i = 0; i < BENCH_HOT_OPS; i++)
+    ht_get(ht, keys[i % hot]);
+  report("ht_get (hot)", BENCH_HOT_OPS, now_ns() - t);
+
+  t = now_ns();
+  for (size_t i = 0; i < n; i++)
+    ht_remove(ht, keys[i]);
+  report("ht_remove", n, now_ns() - t);
+
+  if (found != n)
+    fprintf(stderr, "ht: expected %zu hits, got %zu\n", n, found);
+  ht_destroy(ht);
+}
+
+void bench_open(char** keys, char** misses, const size_t n) {
+  size_t found = 0;
+  oa_table* oa = oa_create(0, str_hash, str_eq, NULL, NULL);
+  if (!oa) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+
+  double t = now_ns();
+  for (size_t i = 0; i < n; i++)
+    oa_insert(oa, keys[i], keys[i]);
+  report("oa_insert", n, now_ns() - t);
+
+  shuffle(keys, n);
+  t = now_ns();
+  for (size_t i = 0; i < n; i++)
+    found += oa_get(oa, keys[i]) != NULL;
+  report("oa_get (hit)", n, now_ns() - t);
+
+  t = now_ns();
+  for (size_t i = 0; i < n; i++)
+    found += oa_get(oa, misses[i]) != NULL;
+  report("oa_get (miss)", n, now_ns() - t);
+
+  /* Cache resident lookups, dominated by hashing and indexing */
+  size_t hot = n < BENCH_HOT_KEYS ? n : BENCH_HOT_KEYS;
+  t = now_ns();
+  for (size_t i = 0; i < BENCH_HOT_OPS; i++)
+    oa_get(oa, keys[i % hot]);
+  report("oa_get (hot)", BENCH_HOT_OPS, now_ns() - t);
+
+  t = now_ns();
+  for (size_t i = 0; i < n; i++)
+    oa_remove(oa, keys[i]);
+  report("oa_remove", n, now_ns() - t);
+
+  if (found != n)
+    fprintf(stderr, "oa: expected %zu hits, got %zu\n", n, found);
+  oa_destroy(oa);
+}
+
+/* Mask indexing with ht_mix against the modulo of the raw hash, on the
+   baseline table with the same power-of-two capacities, so only the
+   index computation differs */
+void bench_index(char** keys, const size_t n) {
+  static const char* names[2][4] = {
+      {"mask insert", "mask get (hit)", "mask get (hot)", "mask remove"},
+      {"modulo insert", "modulo get (hit)", "modulo get (hot)",
+       "modulo remove"}};
+  size_t hot = n < BENCH_HOT_KEYS ? n : BENCH_HOT_KEYS;
+  for (int modulo = 0; modulo < 2; modulo++) {
+    size_t found = 0;
+    base_table* bt = base_create(str_hash, str_eq, modulo);
+    if (!bt) {
+      fprintf(stderr, "Failed to create hash table\n");
+      abort();
+    }
+
+    double t = now_ns();
+    for (size_t i = 0; i < n; i++)
+      base_insert(bt, keys[i], keys[i]);
+    report(names[modulo][0], n, now_ns() - t);
+
+    shuffle(keys, n);
+    t = now_ns();
+    for (size_t i = 0; i < n; i++)
+      found += base_get(bt, keys[i]) != NULL;
+    report(names[modulo][1], n, now_ns() - t);
+
+    t = now_ns();
+    for (size_t i = 0; i < BENCH_HOT_OPS; i++)
+      base_get(bt, keys[i % hot]);
+    report(names[modulo][2], BENCH_HOT_OPS, now_ns() - t);
+
+    t = now_ns();
+    for (size_t i = 0; i < n; i++)
+      base_remove(bt, keys[i]);
+    report(names[modulo][3], n, now_ns() - t);
+
+    if (found != n)
+      fprintf(stderr, "base: expected %zu hits, got %zu\n", n, found);
+    base_destroy(bt);
+  }
+}
+
+/* Batched lookups against a loop of ht_get, both in random order. With
+   the default key count the table is far larger than the last level
+   cache, so nearly every lookup misses on the bucket and on the entry. */
+void bench_get_many(char** keys, const size_t n) {
+  size_t found = 0;
+  void** values = malloc(BENCH_BATCH * sizeof(void*));
+  hash_table* ht = ht_create(0, str_hash, str_eq, NULL, NULL);
+  if (!ht || !values) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+  for (size_t i = 0; i < n; i++)
+    ht_insert(ht, keys[i], keys[i]);
+  shuffle(keys, n);
+
+  double t = now_ns();
+  for (size_t i = 0; i < n; i++)
+    found += ht_get(ht, keys[i]) != NULL;
+  report("ht_get (loop)", n, now_ns() - t);
+
+  t = now_ns();
+  for (size_t i = 0; i < n; i += BENCH_BATCH) {
+    size_t count = n - i < BENCH_BATCH ? n - i : BENCH_BATCH;
+    found += ht_get_many(ht, (const void* const*)&keys[i], count, values);
+  }
+  report("ht_get_many", n, now_ns() - t);
+
+  if (found != 2 * n)
+    fprintf(stderr, "ht: expected %zu hits, got %zu\n", 2 * n, found);
+  ht_destroy(ht);
+  free(values);
+}
+
+/* User hash and key_eq calls made by the dictionary benchmark */
+static size_t dict_hash_calls, dict_eq_calls;
+
+static size_t counting_hash(const void* key) {
+  dict_hash_calls++;
+  return str_hash(key);
+}
+
+/* No pointer shortcut, the keys are not interned */
+static int counting_eq(const void* a, const void* b) {
+  dict_eq_calls++;
+  return strcmp((const char*)a, (const char*)b) == 0;
+}
+
+/* Plain malloc entries, so the tables in bench_dict differ only in the
+   cached hash and not in the entry allocator */
+static void* dict_alloc(void* ctx, size_t size) {
+  (void)ctx;
+  return malloc(size);
+}
+
+static void dict_free_entry(void* ctx, void* ptr) {
+  (void)ctx;
+  free(ptr);
+}
+
+static void report_dict(const char* name, const size_t ops, const double ns) {
+  report(name, ops, ns);
+  printf("%-28s %10.2f\n", "  hash calls per insert",
+         (double)dict_hash_calls / (double)ops);
+  printf("%-28s %10.2f\n", "  key_eq calls per insert",
+         (double)dict_eq_calls / (double)ops);
+}
+
+/* The example 4 load: every dictionary line inserted in file order into a
+   table that grows from the default capacity, with and without cached
+   entry hashes. Reports the user hash and key_eq calls per insert: the
+   cached hashes keep them at one hash call and about one key_eq call per
+   repeated key, the baseline rehashes on every resize and compares every
+   entry of a chain. */
+void bench_dict(void) {
+  dict_file* dict = dict_load(BENCH_DICT_PATH);
+  if (!dict) {
+    printf("%s not found, skipping the dictionary benchmark\n",
+           BENCH_DICT_PATH);
+    return;
+  }
+  ht_allocator alloc = {dict_alloc, dict_free_entry, NULL, NULL};
+  size_t ops = dict->count * BENCH_DICT_ROUNDS;
+  double ns = 0;
+  dict_hash_calls = dict_eq_calls = 0;
+  for (int r = 0; r < BENCH_DICT_ROUNDS; r++) {
+    hash_table* ht = ht_create_with_allocator(0, counting_hash, counting_eq,
+                                              NULL, NULL, &alloc);
+    if (!ht) {
+      fprintf(stderr, "Failed to create hash table\n");
+      abort();
+    }
+    double t = now_ns();
+    for (size_t i = 0; i < dict->count; i++)
+      ht_insert(ht, dict->entries[i].trad, &dict->entries[i]);
+    ns += now_ns() - t;
+    ht_destroy(ht);
+  }
+  report_dict("ht_insert (dictionary)", ops, ns);
+
+  ns = 0;
+  dict_hash_calls = dict_eq_calls = 0;
+  for (int r = 0; r < BENCH_DICT_ROUNDS; r++) {
+    base_table* bt = base_create(counting_hash, counting_eq, 0);
+    if (!bt) {
+      fprintf(stderr, "Failed to create hash table\n");
+      abort();
+    }
+    double t = now_ns();
+    for (size_t i = 0; i < dict->count; i++)
+      base_insert(bt, dict->entries[i].trad, &dict->entries[i]);
+    ns += now_ns() - t;
+    base_destroy(bt);
+  }
+  report_dict("  uncached baseline", ops, ns);
+  dict_free(dict);
+}
+
+void bench_insert_latency(char** keys, const size_t n, const int incremental) {
+  double* lat = malloc(n * sizeof(double));
+  hash_table* ht = ht_create(0, str_hash, str_eq, NULL, NULL);
+  if (!ht || !lat) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+  ht_set_incremental(ht, incremental);
+
+  for (size_t i = 0; i < n; i++) {
+    double t = now_ns();
+    ht_insert(ht, keys[i], keys[i]);
+    lat[i] = now_ns() - t;
+  }
+  report_latency(incremental ? "ht_insert (incremental)" : "ht_insert", lat,
+                 n);
+
+  double t = now_ns();
+  ht_destroy(ht);
+  report("ht_destroy (full table)", n, now_ns() - t);
+  free(lat);
+}
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_N;
+  if (n == 0)
+    n = BENCH_DEFAULT_N;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t threads = argc > 2 ? strtoul(argv[2], NULL, 10) : (size_t)cpus;
+  if (threads == 0)
+    threads = 1;
+
+  char** keys = make_keys(n, "key-");
+  char** misses = make_keys(n, "miss-");
+
+  printf("Hash table benchmark, %zu string keys\n", n);
+  bench_chained(keys, misses, n);
+  bench_open(keys, misses, n);
+  bench_index(keys, n);
+  bench_get_many(keys, n);
+  bench_dict();
+  bench_insert_latency(keys, n, 0);
+  bench_insert_latency(keys, n, 1);
+  bench_concurrent(keys, n, threads);
+
+  free_keys(keys, n);
+  free_keys(misses, n);
+  return 0;
+}
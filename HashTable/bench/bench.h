@@ -0,0 +1,31 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BENCH_DEFAULT_N 1000000
+
+/* Helpers */
+double now_ns(void);
+uint64_t splitmix64(uint64_t x);
+size_t str_hash(const void* key);
+int str_eq(const void* a, const void* b);
+char** make_keys(const size_t n, const char* prefix);
+void free_keys(char** keys, const size_t n);
+void shuffle(char** keys, const size_t n);
+void report(const char* name, const size_t ops, const double ns);
+int cmp_double(const void* a, const void* b);
+void report_latency(const char* name, double* lat, const size_t n);
+
+/* Workloads */
+void bench_chained(char** keys, char** misses, const size_t n);
+void bench_open(char** keys, char** misses, const size_t n);
+void bench_index(char** keys, const size_t n);
+void bench_get_many(char** keys, const size_t n);
+void bench_dict(void);
+void bench_insert_latency(char** keys, const size_t n, const int incremental);
+void bench_concurrent(char** keys, const size_t n, const size_t max_threads);
+int main(int argc, char** argv);
+
+#endif
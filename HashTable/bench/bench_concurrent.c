@@ -0,0 +1,152 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "hashtable.h"
+#include "hashtable_concurrent.h"
+#include "hashtable_rcu.h"
+
+#define BENCH_THREAD_OPS 1000000
+#define BENCH_WRITE_PERCENT 1
+
+/* Table kinds compared by the throughput run */
+enum { TABLE_LOCKED, TABLE_STRIPED, TABLE_RCU };
+
+/* The status quo: one chained table behind a global mutex */
+typedef struct locked_table {
+  pthread_mutex_t lock;
+  hash_table* ht;
+} locked_table;
+
+typedef struct worker {
+  pthread_t thread;
+  int kind;
+  void* table;
+  char** keys;
+  size_t n;
+  size_t ops;
+  uint64_t seed;
+  size_t errors;
+} worker;
+
+static void* locked_worker(void* arg) {
+  worker* w = arg;
+  locked_table* lt = w->table;
+  uint64_t r = w->seed;
+  for (size_t i = 0; i < w->ops; i++) {
+    r = splitmix64(r);
+    char* key = w->keys[r % w->n];
+    pthread_mutex_lock(&lt->lock);
+    if ((r >> 32) % 100 < BENCH_WRITE_PERCENT)
+      ht_insert(lt->ht, key, key);
+    else if (ht_get(lt->ht, key) != key)
+      w->errors++;
+    pthread_mutex_unlock(&lt->lock);
+  }
+  return NULL;
+}
+
+static void* concurrent_worker(void* arg) {
+  worker* w = arg;
+  cht_table* cht = w->table;
+  uint64_t r = w->seed;
+  for (size_t i = 0; i < w->ops; i++) {
+    r = splitmix64(r);
+    char* key = w->keys[r % w->n];
+    if ((r >> 32) % 100 < BENCH_WRITE_PERCENT)
+      cht_insert(cht, key, key);
+    else if (cht_get(cht, key) != key)
+      w->errors++;
+  }
+  return NULL;
+}
+
+static void* rcu_worker(void* arg) {
+  worker* w = arg;
+  rht_table* rht = w->table;
+  uint64_t r = w->seed;
+  for (size_t i = 0; i < w->ops; i++) {
+    r = splitmix64(r);
+    char* key = w->keys[r % w->n];
+    if ((r >> 32) % 100 < BENCH_WRITE_PERCENT)
+      rht_insert(rht, key, key);
+    else if (rht_get(rht, key) != key)
+      w->errors++;
+  }
+  return NULL;
+}
+
+/* Runs the read-mostly mix on the given number of threads, returns the
+   total throughput in operations per second */
+static double run_mix(const int kind,
+                      void* table,
+                      char** keys,
+                      const size_t n,
+                      const size_t threads) {
+  void* (*fn)(void*) = kind == TABLE_LOCKED    ? locked_worker
+                       : kind == TABLE_STRIPED ? concurrent_worker
+                                               : rcu_worker;
+  worker* workers = calloc(threads, sizeof(worker));
+  double t = now_ns();
+  for (size_t i = 0; i < threads; i++) {
+    workers[i].kind = kind;
+    workers[i].table = table;
+    workers[i].keys = keys;
+    workers[i].n = n;
+    workers[i].ops = BENCH_THREAD_OPS;
+    workers[i].seed = i + 1;
+    pthread_create(&workers[i].thread, NULL, fn, &workers[i]);
+  }
+  size_t errors = 0;
+  for (size_t i = 0; i < threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    errors += workers[i].errors;
+  }
+  t = now_ns() - t;
+  if (errors)
+    fprintf(stderr, "%zu lookups returned a wrong value\n", errors);
+  free(workers);
+  return (double)(threads * BENCH_THREAD_OPS) / t * 1e9;
+}
+
+/* ---------- Throughput ---------- */
+
+void bench_concurrent(char** keys, const size_t n, const size_t max_threads) {
+  locked_table lt;
+  pthread_mutex_init(&lt.lock, NULL);
+  lt.ht = ht_create(0, str_hash, str_eq, NULL, NULL);
+  cht_table* cht = cht_create(0, str_hash, str_eq, NULL, NULL);
+  rht_table* rht = rht_create(0, str_hash, str_eq, NULL, NULL);
+  if (!lt.ht || !cht || !rht) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+  for (size_t i = 0; i < n; i++) {
+    ht_insert(lt.ht, keys[i], keys[i]);
+    cht_insert(cht, keys[i], keys[i]);
+    rht_insert(rht, keys[i], keys[i]);
+  }
+
+  printf("Read-mostly mix (%d%% writes), %d ops per thread:\n",
+         BENCH_WRITE_PERCENT, BENCH_THREAD_OPS);
+  for (size_t t = 1;; t *= 2) {
+    if (t > max_threads)
+      t = max_threads;
+    double locked = run_mix(TABLE_LOCKED, &lt, keys, n, t);
+    double striped = run_mix(TABLE_STRIPED, cht, keys, n, t);
+    double rcu = run_mix(TABLE_RCU, rht, keys, n, t);
+    printf("  %3zu threads: global mutex %8.2f, striped %8.2f, rcu %8.2f"
+           " Mops/s\n",
+           t, locked / 1e6, striped / 1e6, rcu / 1e6);
+    if (t == max_threads)
+      break;
+  }
+
+  ht_destroy(lt.ht);
+  pthread_mutex_destroy(&lt.lock);
+  cht_destroy(cht);
+  rht_destroy(rht);
+}
@@ -0,0 +1,737 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epoch.h"
+#include "hashtable.h"
+#include "hashtable_concurrent.h"
+#include "hashtable_oa.h"
+#include "hashtable_rcu.h"
+
+/* Checks of the hash tables. The single-threaded passes run random
+   operations on a small key range against a reference array and validate
+   the table layout as they go. The concurrent tables are stressed from
+   several threads, and every thread checks what it reads against what it
+   wrote itself. Any mismatch aborts, so make check fails. */
+
+#define CHECK_KEYS 512
+#define CHECK_DEFAULT_OPS 200000
+/* Operations between two full structure checks */
+#define CHECK_EVERY 97
+/* Distinct hashes of the clustered hash function */
+#define CHECK_CLUSTERS 8
+#define CHECK_STRESS_THREADS 8
+/* Keys every stress thread reads while the others write */
+#define CHECK_SHARED_KEYS 10000
+#define CHECK_RCU_KEYS 10000
+#define CHECK_RCU_READERS 4
+
+int main(int argc, char** argv);
+
+/* Reference: tag[k] is the tag stored under key k, 0 if absent */
+typedef struct check_ref {
+  uintptr_t tag[CHECK_KEYS];
+  size_t size;
+} check_ref;
+
+static int key_vals[CHECK_KEYS];
+static uint64_t rng_state;
+static long live_data; /* values not freed yet */
+static uintptr_t next_tag;
+
+/* ---------- Helpers ---------- */
+
+static uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static uint64_t rng_next(void) {
+  return splitmix64(rng_state++);
+}
+
+static size_t rng_below(const size_t n) {
+  return (size_t)(rng_next() % n);
+}
+
+static void fail(const char* pass, const char* what, const size_t op) {
+  fprintf(stderr, "%s: %s (after %zu ops)\n", pass, what, op);
+  abort();
+}
+
+static size_t int_hash(const void* key) {
+  return (size_t)*(const int*)key;
+}
+
+/* Only CHECK_CLUSTERS distinct hashes, so keys share whole probe
+   sequences and chains */
+static size_t clustered_hash(const void* key) {
+  return (size_t)(*(const int*)key % CHECK_CLUSTERS);
+}
+
+static int int_eq(const void* a, const void* b) {
+  return *(const int*)a == *(const int*)b;
+}
+
+/* Values are heap tags, so the table's ownership of values can be
+   checked */
+static uintptr_t* make_data(void) {
+  uintptr_t* d = malloc(sizeof(uintptr_t));
+  if (!d) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  *d = ++next_tag;
+  live_data++;
+  return d;
+}
+
+static void free_data(void* ptr) {
+  live_data--;
+  free(ptr);
+}
+
+static void ref_init(check_ref* ref) {
+  memset(ref, 0, sizeof(*ref));
+}
+
+static void ref_set(check_ref* ref, const int k, const uintptr_t tag) {
+  ref->size += ref->tag[k] == 0;
+  ref->tag[k] = tag;
+}
+
+static void ref_clear(check_ref* ref, const int k) {
+  ref->size -= ref->tag[k] != 0;
+  ref->tag[k] = 0;
+}
+
+static void count_item(const void* key, const void* value, void* user_data) {
+  (void)key;   /* unused */
+  (void)value; /* unused */
+  (*(size_t*)user_data)++;
+}
+
+/* djb2, the same weak hash the demo uses */
+static size_t str_hash(const void* key) {
+  const char* s = key;
+  size_t h = 5381;
+  while (*s)
+    h = ((h << 5) + h) + (unsigned char)*s++;
+  return h;
+}
+
+static int str_eq(const void* a, const void* b) {
+  return strcmp((const char*)a, (const char*)b) == 0;
+}
+
+static char* copy_str(const char* s) {
+  char* p = malloc(strlen(s) + 1);
+  if (!p) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  strcpy(p, s);
+  return p;
+}
+
+/* n distinct keys, each the prefix and its index */
+static char** make_keys(const size_t n, const char* prefix) {
+  char** keys = malloc((n ? n : 1) * sizeof(char*));
+  char buf[64];
+  if (!keys) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  for (size_t i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "%s%zu", prefix, i);
+    keys[i] = copy_str(buf);
+  }
+  return keys;
+}
+
+static void free_keys(char** keys, const size_t n) {
+  for (size_t i = 0; i < n; i++)
+    free(keys[i]);
+  free(keys);
+}
+
+/* ---------- Chained table ---------- */
+
+/* Allocator without bulk release, so ht_destroy has to free every entry
+   itself */
+static long live_entries;
+
+static void* check_alloc(void* ctx, size_t size) {
+  (void)ctx; /* unused */
+  void* p = malloc(size);
+  if (p)
+    live_entries++;
+  return p;
+}
+
+static void check_free(void* ctx, void* ptr) {
+  (void)ctx; /* unused */
+  live_entries--;
+  free(ptr);
+}
+
+/* Incremental resize cases a pass has run into, see pass_chained */
+typedef struct ht_events {
+  size_t migrating;  /* operations while a migration was pending */
+  size_t checked;    /* check_chained calls during a migration */
+  size_t switched;   /* ht_set_incremental(ht, 0) during a migration */
+  size_t destroyed;  /* ht_destroy during a migration */
+} ht_events;
+
+/* Marks each visited key, so ht_foreach must visit every key once */
+typedef struct visit {
+  const check_ref* ref;
+  int seen[CHECK_KEYS];
+  size_t count;
+  int bad;
+} visit;
+
+static void visit_item(const void* key, const void* value, void* user_data) {
+  visit* v = user_data;
+  int k = *(const int*)key;
+  if (v->seen[k]++ || *(const uintptr_t*)value != v->ref->tag[k])
+    v->bad = 1;
+  v->count++;
+}
+
+/* Checks one bucket array: every entry sits in the bucket its cached hash
+   selects, and that hash is the mixed hash of its key */
+static size_t check_buckets(const hash_table* ht,
+                            ht_entry** buckets,
+                            const size_t from,
+                            const size_t to,
+                            const size_t capacity,
+                            const check_ref* ref,
+                            int* seen,
+                            const char* pass,
+                            const size_t op) {
+  size_t count = 0;
+  for (size_t i = from; i < to; i++) {
+    for (ht_entry* e = buckets[i]; e; e = e->next) {
+      int k = *(int*)e->key;
+      if (e->hash != ht_mix(ht->hash(e->key)))
+        fail(pass, "cached hash differs from the key's", op);
+      if ((e->hash & (capacity - 1)) != i)
+        fail(pass, "entry in the wrong bucket", op);
+      if (seen[k]++)
+        fail(pass, "key stored twice", op);
+      if (ref->tag[k] == 0 || *(uintptr_t*)e->value != ref->tag[k])
+        fail(pass, "entry holds a key or value the reference lacks", op);
+      count++;
+    }
+  }
+  return count;
+}
+
+/* ht_get_many on a random mix of hits and misses, n not a multiple of
+   HT_GET_BATCH, must give what ht_get gives for each key */
+static void check_get_many(const hash_table* ht,
+                           const char* pass,
+                           const size_t op) {
+  const void* keys[3 * HT_GET_BATCH + 1];
+  void* values[3 * HT_GET_BATCH + 1];
+  size_t n = 1 + rng_below(3 * HT_GET_BATCH);
+  if (n % HT_GET_BATCH == 0)
+    n++;
+  size_t hits = 0;
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = &key_vals[rng_below(CHECK_KEYS)];
+    values[i] = &values[i]; /* must be overwritten */
+  }
+  size_t found = ht_get_many(ht, keys, n, values);
+  for (size_t i = 0; i < n; i++) {
+    void* v = ht_get(ht, keys[i]);
+    if (values[i] != v)
+      fail(pass, "ht_get_many value differs from ht_get", op);
+    hits += v != NULL;
+  }
+  if (found != hits)
+    fail(pass, "ht_get_many count differs from its hits", op);
+}
+
+/* Both bucket arrays, lookups and iteration against the reference */
+static void check_chained(const hash_table* ht,
+                          const check_ref* ref,
+                          const char* pass,
+                          const size_t op) {
+  int seen[CHECK_KEYS] = {0};
+  size_t count = 0;
+  if (ht->old_buckets) {
+    if (ht->migrate_pos >= ht->old_capacity ||
+        ht->capacity != 2 * ht->old_capacity)
+      fail(pass, "migration state out of range", op);
+    for (size_t i = 0; i < ht->migrate_pos; i++)
+      if (ht->old_buckets[i])
+        fail(pass, "migrated old bucket not empty", op);
+    count += check_buckets(ht, ht->old_buckets, ht->migrate_pos,
+                           ht->old_capacity, ht->old_capacity, ref, seen,
+                           pass, op);
+  }
+  count += check_buckets(ht, ht->buckets, 0, ht->capacity, ht->capacity, ref,
+                         seen, pass, op);
+  if (count != ht->size || count != ref->size)
+    fail(pass, "size differs from the reference", op);
+
+  for (int k = 0; k < CHECK_KEYS; k++) {
+    uintptr_t* d = ht_get(ht, &key_vals[k]);
+    if ((d ? *d : 0) != ref->tag[k])
+      fail(pass, "ht_get differs from the reference", op);
+  }
+
+  visit v;
+  memset(&v, 0, sizeof(v));
+  v.ref = ref;
+  ht_foreach(ht, visit_item, 0, &v);
+  if (v.bad || v.count != ref->size)
+    fail(pass, "ht_foreach missed a key or visited one twice", op);
+  size_t limited = 0;
+  ht_foreach(ht, count_item, 3, &limited);
+  if (limited != (ref->size < 3 ? ref->size : 3))
+    fail(pass, "ht_foreach ignored its limit", op);
+  check_get_many(ht, pass, op);
+}
+
+/* Rounds of ht_insert, ht_remove and lookups on tables that start with 16
+   buckets, mostly in incremental mode; the full checks include
+   ht_get_many. Now and then incremental mode is switched off, which
+   finishes a running migration, and back on. A round ends with
+   ht_destroy, preferably while a migration is pending. The pass fails if
+   lookups, ht_get_many, iteration, switching off or destroying never
+   happened mid-migration, or if a resize ever had to finish the previous
+   migration first (HT_REHASH_STEP is meant to rule that out). */
+static void pass_chained(const size_t ops, const ht_allocator* alloc) {
+  const char* pass = alloc ? "chained (malloc entries)" : "chained";
+  check_ref ref;
+  ht_events ev;
+  memset(&ev, 0, sizeof(ev));
+  size_t op = 0;
+  while (op < ops) {
+    hash_table* ht =
+        ht_create_with_allocator(16, int_hash, int_eq, NULL, free_data, alloc);
+    if (!ht) {
+      fprintf(stderr, "Failed to create hash table\n");
+      abort();
+    }
+    ht_set_incremental(ht, 1);
+    ref_init(&ref);
+    size_t end = op + rng_below(1500);
+    for (; op < ops; op++) {
+      int migrating = ht->old_buckets != NULL;
+      if (op >= end && (migrating || rng_below(256) == 0))
+        break;
+      ev.migrating += migrating;
+      int k = (int)rng_below(CHECK_KEYS);
+      size_t r = rng_below(1000);
+      if (r < 5) {
+        ev.switched += migrating && ht->incremental;
+        ht_set_incremental(ht, !ht->incremental);
+        if (!ht->incremental && ht->old_buckets)
+          fail(pass, "switching off left a migration pending", op);
+      } else if (r < 600) {
+        size_t capacity = ht->capacity;
+        uintptr_t* d = make_data();
+        if (ht_insert(ht, &key_vals[k], d) != 0)
+          fail(pass, "ht_insert failed", op);
+        if (migrating && ht->capacity != capacity)
+          fail(pass, "a resize had to finish the previous migration", op);
+        ref_set(&ref, k, *d);
+      } else if (r < 850) {
+        int removed = ht_remove(ht, &key_vals[k]);
+        if ((removed == 0) != (ref.tag[k] != 0))
+          fail(pass, "ht_remove result differs from the reference", op);
+        ref_clear(&ref, k);
+      } else {
+        uintptr_t* d = ht_get(ht, &key_vals[k]);
+        if ((d ? *d : 0) != ref.tag[k])
+          fail(pass, "ht_get differs from the reference", op);
+      }
+      if (op % CHECK_EVERY == 0 || (migrating && rng_below(16) == 0)) {
+        ev.checked += ht->old_buckets != NULL;
+        check_chained(ht, &ref, pass, op);
+      }
+    }
+    ev.destroyed += ht->old_buckets != NULL;
+    ht_destroy(ht);
+    if (live_data != 0 || live_entries != 0)
+      fail(pass, "ht_destroy leaked or freed twice", op);
+  }
+  if (!ev.migrating || !ev.checked || !ev.switched || !ev.destroyed)
+    fail(pass, "some mid-migration case never came up", ops);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* ---------- Open addressing ---------- */
+
+/* Layout events a pass has run into, see pass_open */
+typedef struct oa_events {
+  size_t tombstones;    /* removals that left a tombstone */
+  size_t emptied;       /* removals that left the slot empty */
+  size_t reused;        /* inserts into a tombstone */
+  size_t cleaned;       /* same-size rehashes dropping tombstones */
+  size_t grown;         /* rehashes into a larger array */
+  size_t wrapped;       /* keys found after the probe wrapped around */
+} oa_events;
+
+/* Control bytes, slots and contents against the reference. Every key
+   must be reachable from the start of its probe sequence, through groups
+   without an empty slot. */
+static void check_open(const oa_table* oa,
+                       const check_ref* ref,
+                       oa_events* ev,
+                       const char* pass,
+                       const size_t op) {
+  size_t groups = oa->capacity / OA_GROUP_WIDTH;
+  size_t full = 0, deleted = 0;
+  int seen[CHECK_KEYS] = {0};
+  for (size_t i = 0; i < oa->capacity; i++) {
+    uint8_t c = oa->ctrl[i];
+    if (c == OA_CTRL_EMPTY)
+      continue;
+    if (c == OA_CTRL_DELETED) {
+      deleted++;
+      continue;
+    }
+    if (c & 0x80)
+      fail(pass, "invalid control byte", op);
+    int k = *(int*)oa->slots[i].key;
+    size_t h = ht_mix(oa->hash(&key_vals[k]));
+    if (seen[k]++)
+      fail(pass, "key stored twice", op);
+    if (ref->tag[k] == 0 || *(uintptr_t*)oa->slots[i].value != ref->tag[k])
+      fail(pass, "slot holds a key or value the reference lacks", op);
+    if (c != (h & 0x7F))
+      fail(pass, "control byte is not the key's hash tag", op);
+
+    size_t g = (h >> 7) & (groups - 1);
+    int wrapped = 0;
+    for (size_t step = 1; g != i / OA_GROUP_WIDTH; step++) {
+      const uint8_t* ctrl = oa->ctrl + g * OA_GROUP_WIDTH;
+      for (size_t j = 0; j < OA_GROUP_WIDTH; j++)
+        if (ctrl[j] == OA_CTRL_EMPTY)
+          fail(pass, "key behind an empty slot of its probe sequence", op);
+      if (step > groups)
+        fail(pass, "key not on its probe sequence", op);
+      size_t next = (g + step) & (groups - 1);
+      wrapped |= next < g;
+      g = next;
+    }
+    ev->wrapped += wrapped;
+    full++;
+  }
+  if (full != oa->size || full != ref->size)
+    fail(pass, "size differs from the reference", op);
+  if (deleted != oa->deleted)
+    fail(pass, "tombstone count differs from the control bytes", op);
+
+  size_t visited = 0;
+  oa_foreach(oa, count_item, 0, &visited);
+  if (visited != full)
+    fail(pass, "oa_foreach count differs from the size", op);
+  for (int k = 0; k < CHECK_KEYS; k++) {
+    uintptr_t* d = oa_get(oa, &key_vals[k]);
+    if ((d ? *d : 0) != ref->tag[k])
+      fail(pass, "oa_get differs from the reference", op);
+  }
+}
+
+/* Kinds of open addressing pass */
+enum { OA_SPREAD, OA_CLUSTERED, OA_CHURN };
+
+/* oa_insert, oa_remove and oa_get on a table that starts with one group.
+   OA_SPREAD and OA_CLUSTERED alternate phases of growth and shrinking.
+   With the clustered hash, keys pile up on a few probe sequences, which
+   fills groups, leaves tombstones behind and makes the probes wrap
+   around. OA_CHURN inserts all keys of one hash and removes them again,
+   one hash after another: each round leaves tombstones on its own probe
+   sequence, until they force a same-size rehash. Those two passes fail
+   if the cases they are meant for never came up. */
+static void pass_open(const size_t ops, const int mode) {
+  const char* pass = mode == OA_SPREAD      ? "open addressing"
+                     : mode == OA_CLUSTERED ? "open addressing (clustered)"
+                                            : "open addressing (churn)";
+  oa_table* oa = oa_create(OA_GROUP_WIDTH,
+                           mode != OA_SPREAD ? clustered_hash : int_hash,
+                           int_eq, NULL, free_data);
+  check_ref ref;
+  oa_events ev;
+  if (!oa) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+  ref_init(&ref);
+  memset(&ev, 0, sizeof(ev));
+  for (size_t op = 0; op < ops; op++) {
+    int grow = (op / 5000) % 2 == 0;
+    int k = (int)rng_below(CHECK_KEYS);
+    int insert = rng_below(100) < (grow ? 70u : 30u);
+    if (mode == OA_CHURN) {
+      size_t per = CHECK_KEYS / CHECK_CLUSTERS;
+      size_t i = op % (2 * per);
+      insert = i < per;
+      k = (int)((op / (2 * per)) % CHECK_CLUSTERS +
+                CHECK_CLUSTERS * (insert ? i : i - per));
+    }
+    size_t capacity = oa->capacity;
+    size_t deleted = oa->deleted;
+    if (insert) {
+      uintptr_t* d = make_data();
+      int fresh = ref.tag[k] == 0;
+      if (oa_insert(oa, &key_vals[k], d) != 0)
+        fail(pass, "oa_insert failed", op);
+      ref_set(&ref, k, *d);
+      if (oa->capacity > capacity)
+        ev.grown++;
+      else if (fresh && oa->deleted + 1 == deleted)
+        ev.reused++;
+      else if (fresh && oa->deleted + 1 < deleted)
+        ev.cleaned++;
+    } else {
+      int r = oa_remove(oa, &key_vals[k]);
+      if ((r == 0) != (ref.tag[k] != 0))
+        fail(pass, "oa_remove result differs from the reference", op);
+      if (r == 0 && oa->deleted > deleted)
+        ev.tombstones++;
+      else if (r == 0)
+        ev.emptied++;
+      ref_clear(&ref, k);
+    }
+    if (op % CHECK_EVERY == 0)
+      check_open(oa, &ref, &ev, pass, op);
+  }
+  check_open(oa, &ref, &ev, pass, ops);
+  oa_destroy(oa);
+  if (live_data != 0)
+    fail(pass, "values leaked or freed twice", ops);
+  if (mode == OA_CLUSTERED && (!ev.tombstones || !ev.emptied || !ev.reused ||
+                               !ev.grown || !ev.wrapped))
+    fail(pass, "some probe or tombstone case never came up", ops);
+  if (mode == OA_CHURN && !ev.cleaned)
+    fail(pass, "tombstones never forced a rehash", ops);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* ---------- Striped table ---------- */
+
+typedef struct stress_worker {
+  pthread_t thread;
+  cht_table* cht;
+  char** shared;
+  char** own;
+  size_t n; /* own keys */
+  size_t errors;
+} stress_worker;
+
+/* Inserts private keys (forcing stripe resizes), removes every second
+   one again and keeps reading the shared keys meanwhile */
+static void* stress_thread(void* arg) {
+  stress_worker* w = arg;
+  for (size_t i = 0; i < w->n; i++) {
+    cht_insert(w->cht, w->own[i], w->own[i]);
+    char* key = w->shared[(i * 7919) % CHECK_SHARED_KEYS];
+    if (cht_get(w->cht, key) != key)
+      w->errors++;
+    if (cht_get(w->cht, w->own[i]) != w->own[i])
+      w->errors++;
+  }
+  for (size_t i = 1; i < w->n; i += 2)
+    if (cht_remove(w->cht, w->own[i]) != 0)
+      w->errors++;
+  for (size_t i = 0; i < w->n; i++) {
+    void* v = cht_get(w->cht, w->own[i]);
+    if (v != (i % 2 == 0 ? w->own[i] : NULL))
+      w->errors++;
+  }
+  return NULL;
+}
+
+/* CHECK_STRESS_THREADS threads share the ops between them */
+static void pass_striped(const size_t ops) {
+  char pass[64];
+  snprintf(pass, sizeof(pass), "striped (%d threads)", CHECK_STRESS_THREADS);
+  char** shared = make_keys(CHECK_SHARED_KEYS, "shared-");
+  cht_table* cht = cht_create(0, str_hash, str_eq, NULL, NULL);
+  if (!cht) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+  for (size_t i = 0; i < CHECK_SHARED_KEYS; i++)
+    cht_insert(cht, shared[i], shared[i]);
+
+  stress_worker workers[CHECK_STRESS_THREADS];
+  size_t per_thread = ops / CHECK_STRESS_THREADS + 1;
+  char prefix[32];
+  for (size_t t = 0; t < CHECK_STRESS_THREADS; t++) {
+    snprintf(prefix, sizeof(prefix), "stress-%zu-", t);
+    workers[t].cht = cht;
+    workers[t].shared = shared;
+    workers[t].own = make_keys(per_thread, prefix);
+    workers[t].n = per_thread;
+    workers[t].errors = 0;
+    if (pthread_create(&workers[t].thread, NULL, stress_thread,
+                       &workers[t]) != 0)
+      fail(pass, "pthread_create failed", 0);
+  }
+  size_t errors = 0;
+  for (size_t t = 0; t < CHECK_STRESS_THREADS; t++) {
+    pthread_join(workers[t].thread, NULL);
+    errors += workers[t].errors;
+  }
+  if (errors)
+    fail(pass, "lookups or removals differ from what was written", ops);
+  size_t expected =
+      CHECK_SHARED_KEYS + CHECK_STRESS_THREADS * ((per_thread + 1) / 2);
+  if (cht_size(cht) != expected)
+    fail(pass, "size differs from the keys left", ops);
+
+  cht_destroy(cht);
+  for (size_t t = 0; t < CHECK_STRESS_THREADS; t++)
+    free_keys(workers[t].own, per_thread);
+  free_keys(shared, CHECK_SHARED_KEYS);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* ---------- Read-mostly table ---------- */
+
+typedef struct rcu_stress {
+  rht_table* rht;
+  char** keys;
+  atomic_int stop;
+  atomic_size_t next_seed;
+  atomic_size_t errors;
+} rcu_stress;
+
+/* Values not freed yet; they are heap copies of their key, so reading a
+   reclaimed value is caught as a mismatch (or by AddressSanitizer) */
+static atomic_long live_values;
+
+static char* make_value(const char* key) {
+  atomic_fetch_add(&live_values, 1);
+  return copy_str(key);
+}
+
+static void free_value(void* ptr) {
+  atomic_fetch_sub(&live_values, 1);
+  free(ptr);
+}
+
+static void* rcu_stress_reader(void* arg) {
+  rcu_stress* st = arg;
+  size_t errors = 0;
+  uint64_t r = atomic_fetch_add(&st->next_seed, 1);
+  while (!atomic_load_explicit(&st->stop, memory_order_relaxed)) {
+    r = splitmix64(r);
+    char* key = st->keys[r % CHECK_RCU_KEYS];
+    rht_read_lock();
+    char* v = rht_get(st->rht, key);
+    if (v && strcmp(v, key) != 0)
+      errors++;
+    rht_read_unlock();
+  }
+  atomic_fetch_add(&st->errors, errors);
+  return NULL;
+}
+
+/* Removes each visited key while iterating; its value must stay readable
+   until the read-side section ends */
+static size_t rcu_nested_errors;
+
+static void rcu_remove_visited(const void* key,
+                               const void* value,
+                               void* user_data) {
+  if (rht_remove(user_data, key) != 0 || strcmp(value, key) != 0)
+    rcu_nested_errors++;
+}
+
+/* One writer removes, reinserts and replaces keys and grows the table
+   while readers keep looking them up without locks */
+static void pass_rcu(const size_t ops) {
+  char pass[64];
+  snprintf(pass, sizeof(pass), "read-mostly (%d readers)", CHECK_RCU_READERS);
+  rcu_stress st;
+  st.rht = rht_create(16, str_hash, str_eq, NULL, free_value);
+  st.keys = make_keys(CHECK_RCU_KEYS, "rcu-");
+  if (!st.rht) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+  atomic_init(&st.stop, 0);
+  atomic_init(&st.next_seed, rng_next());
+  atomic_init(&st.errors, 0);
+
+  pthread_t threads[CHECK_RCU_READERS];
+  for (size_t t = 0; t < CHECK_RCU_READERS; t++)
+    if (pthread_create(&threads[t], NULL, rcu_stress_reader, &st) != 0)
+      fail(pass, "pthread_create failed", 0);
+  size_t rounds = ops / CHECK_RCU_KEYS + 1;
+  for (size_t round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < CHECK_RCU_KEYS; i++)
+      rht_insert(st.rht, st.keys[i], make_value(st.keys[i]));
+    for (size_t i = round % 2; i < CHECK_RCU_KEYS; i += 2)
+      rht_remove(st.rht, st.keys[i]);
+  }
+  atomic_store(&st.stop, 1);
+  for (size_t t = 0; t < CHECK_RCU_READERS; t++)
+    pthread_join(threads[t], NULL);
+
+  if (atomic_load(&st.errors))
+    fail(pass, "a reader saw a reclaimed or wrong value", ops);
+  if (rht_size(st.rht) != CHECK_RCU_KEYS / 2)
+    fail(pass, "size differs from the keys left", ops);
+
+  /* Writes, resizes and destroying another table inside a read-side
+     section, none of which may wait for readers */
+  rht_read_lock();
+  rht_foreach(st.rht, rcu_remove_visited, 0, st.rht);
+  if (rcu_nested_errors || rht_size(st.rht) != 0)
+    fail(pass, "removing while iterating went wrong", ops);
+  rht_table* other = rht_create(16, str_hash, str_eq, NULL, free_value);
+  if (!other) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+  for (size_t i = 0; i < CHECK_RCU_KEYS; i++) {
+    rht_insert(other, st.keys[i], make_value(st.keys[i]));
+    rht_insert(other, st.keys[i], make_value(st.keys[i]));
+  }
+  rht_destroy(other);
+  rht_read_unlock();
+
+  rht_destroy(st.rht);
+  /* Retired values are freed once their grace period is over */
+  epoch_synchronize();
+  if (atomic_load(&live_values) != 0)
+    fail(pass, "values leaked or freed twice", ops);
+  free_keys(st.keys, CHECK_RCU_KEYS);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+int main(int argc, char** argv) {
+  size_t ops = argc > 1 ? strtoul(argv[1], NULL, 10) : CHECK_DEFAULT_OPS;
+  if (ops == 0)
+    ops = CHECK_DEFAULT_OPS;
+  rng_state = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+  for (int k = 0; k < CHECK_KEYS; k++)
+    key_vals[k] = k;
+
+  ht_allocator counted = {check_alloc, check_free, NULL, NULL};
+  pass_chained(ops, NULL);
+  pass_chained(ops, &counted);
+  pass_open(ops, OA_SPREAD);
+  pass_open(ops, OA_CLUSTERED);
+  pass_open(ops, OA_CHURN);
+  pass_striped(ops);
+  pass_rcu(ops);
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include "epoch.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+static epoch_record epoch_records[EPOCH_MAX_THREADS];
+static atomic_size_t epoch_records_used; /* high water mark of records */
+static atomic_size_t epoch_global = 1;
+static atomic_int epoch_overflow; /* readers without a record */
+
+/* Limbo lists, indexed by the epoch they were retired in, modulo 3 */
+static pthread_mutex_t epoch_lock = PTHREAD_MUTEX_INITIALIZER;
+static epoch_node* epoch_limbo[3];
+
+static _Thread_local epoch_record* epoch_self;
+static _Thread_local unsigned epoch_depth;
+
+static pthread_key_t epoch_key;
+static pthread_once_t epoch_key_once = PTHREAD_ONCE_INIT;
+
+/* Records are handed back when their thread exits */
+static void epoch_release_record(void* ptr) {
+  epoch_record* rec = ptr;
+  atomic_store_explicit(&rec->used, 0, memory_order_release);
+}
+
+static void epoch_make_key(void) {
+  pthread_key_create(&epoch_key, epoch_release_record);
+}
+
+static epoch_record* epoch_register(void) {
+  pthread_once(&epoch_key_once, epoch_make_key);
+  for (size_t i = 0; i < EPOCH_MAX_THREADS; i++) {
+    int expected = 0;
+    if (!atomic_compare_exchange_strong(&epoch_records[i].used, &expected, 1))
+      continue;
+    size_t used = atomic_load(&epoch_records_used);
+    while (used < i + 1 &&
+           !atomic_compare_exchange_weak(&epoch_records_used, &used, i + 1))
+      ;
+    pthread_setspecific(epoch_key, &epoch_records[i]);
+    return &epoch_records[i];
+  }
+  return NULL;
+}
+
+void epoch_enter(void) {
+  if (epoch_depth++ > 0)
+    return;
+  if (!epoch_self)
+    epoch_self = epoch_register();
+  if (!epoch_self) {
+    atomic_fetch_add(&epoch_overflow, 1);
+    return;
+  }
+  size_t e = atomic_load_explicit(&epoch_global, memory_order_acquire);
+  atomic_store_explicit(&epoch_self->state, (e << 1) | 1,
+                        memory_order_relaxed);
+  /* The announcement must be visible before any shared node is read */
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+void epoch_exit(void) {
+  if (--epoch_depth > 0)
+    return;
+  if (epoch_self)
+    atomic_store_explicit(&epoch_self->state, 0, memory_order_release);
+  else
+    atomic_fetch_sub_explicit(&epoch_overflow, 1, memory_order_release);
+}
+
+/* Advances the global epoch if every active reader has seen the current
+   one. Returns the list that became safe to free. Called with the lock. */
+static epoch_node* epoch_try_advance(void) {
+  atomic_thread_fence(memory_order_seq_cst);
+  size_t g = atomic_load_explicit(&epoch_global, memory_order_relaxed);
+  if (atomic_load_explicit(&epoch_overflow, memory_order_acquire) > 0)
+    return NULL;
+  size_t used = atomic_load_explicit(&epoch_records_used, memory_order_acquire);
+  for (size_t i = 0; i < used; i++) {
+    size_t s =
+        atomic_load_explicit(&epoch_records[i].state, memory_order_acquire);
+    if ((s & 1) && (s >> 1) != g)
+      return NULL;
+  }
+  g++;
+  atomic_store_explicit(&epoch_global, g, memory_order_release);
+  /* Objects retired two epochs ago are unreachable by now */
+  epoch_node* done = epoch_limbo[(g + 1) % 3];
+  epoch_limbo[(g + 1) % 3] = NULL;
+  return done;
+}
+
+/* Frees a detached limbo list. Runs with the lock held, so once
+   epoch_synchronize returns no callback is still running. */
+static void epoch_reclaim(epoch_node* r) {
+  while (r) {
+    epoch_node* next = r->next;
+    r->fn(r, r->ctx);
+    r = next;
+  }
+}
+
+void epoch_retire(epoch_node* node, epoch_free_func fn, void* ctx) {
+  node->fn = fn;
+  node->ctx = ctx;
+  pthread_mutex_lock(&epoch_lock);
+  size_t g = atomic_load_explicit(&epoch_global, memory_order_relaxed);
+  node->next = epoch_limbo[g % 3];
+  epoch_limbo[g % 3] = node;
+  epoch_reclaim(epoch_try_advance());
+  pthread_mutex_unlock(&epoch_lock);
+}
+
+/* Waits until everything retired so far has been freed, i.e. two epoch
+   advances. Must not be called from inside a read-side section. */
+void epoch_synchronize(void) {
+  size_t target = atomic_load(&epoch_global) + 2;
+  for (;;) {
+    pthread_mutex_lock(&epoch_lock);
+    epoch_reclaim(epoch_try_advance());
+    int finished = atomic_load(&epoch_global) >= target;
+    pthread_mutex_unlock(&epoch_lock);
+    if (finished)
+      return;
+    sched_yield();
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/* Maximum number of threads inside read-side sections at the same time
+   with their own record; further threads fall back to a shared counter
+   that holds back reclamation while they read */
+#define EPOCH_MAX_THREADS 128
+#define EPOCH_CACHE_LINE 64
+
+typedef struct epoch_node epoch_node;
+
+/* Reclaims the object holding node; must not call back into epoch_* */
+typedef void (*epoch_free_func)(epoch_node* node, void* ctx);
+
+/* Link of a retired object, embedded in every object that is handed to
+   epoch_retire, so retiring never allocates and never fails */
+struct epoch_node {
+  epoch_node* next;
+  epoch_free_func fn;
+  void* ctx;
+};
+
+/* The object of the given type whose member is node */
+#define EPOCH_CONTAINER(node, type, member) \
+  ((type*)((char*)(node) - offsetof(type, member)))
+
+/* Per-thread record. state is 0 outside read-side sections, otherwise the
+   announced epoch shifted left by one with the low bit set. */
+typedef struct epoch_record {
+  _Alignas(EPOCH_CACHE_LINE) atomic_size_t state;
+  atomic_int used;
+} epoch_record;
+
+/* API
+   Process-wide epoch based reclamation. Readers bracket every access to
+   shared nodes with epoch_enter/epoch_exit (nesting is allowed); writers
+   unlink an object first and then hand its epoch_node to epoch_retire,
+   which reclaims it once no reader that could still see it is left.
+   epoch_retire never waits, so it may be called inside a read-side
+   section; only epoch_synchronize must not be. */
+void epoch_enter(void);
+void epoch_exit(void);
+void epoch_retire(epoch_node* node, epoch_free_func fn, void* ctx);
+void epoch_synchronize(void);
+
+#endif
@@ -1,56 +1,165 @@
 #include "hashtable.h"
 
 #include <stdlib.h>
+#include <string.h>
 
-/* Internal Helper */
+#include "slab.h"
+
+/* Internal Helpers */
 static int ht_resize(hash_table* ht, const size_t new_capacity);
+static int ht_resize_begin(hash_table* ht, const size_t new_capacity);
+static void ht_rehash_step(hash_table* ht, size_t buckets);
+
+/* Statistics, compiled out unless CONTAINER_STATS is defined. Lookups
+   through a const table update them too. */
+#ifdef CONTAINER_STATS
+#define HT_STAT_ADD(ht, field, n) (((hash_table*)(ht))->stats.field += (n))
+static void ht_stat_chain(const hash_table* ht, const size_t walked) {
+  ht_statistics* s = &((hash_table*)ht)->stats;
+  s->lookups++;
+  s->chain[walked < HT_STATS_CHAIN ? walked : HT_STATS_CHAIN - 1]++;
+}
+#else
+#define HT_STAT_ADD(ht, field, n) ((void)0)
+#define ht_stat_chain(ht, walked) ((void)(walked))
+#endif
+
+/* Capacity is kept a power of two so indexing is a mask */
+static size_t ht_round_capacity(const size_t capacity) {
+  size_t c = 1;
+  while (c < capacity)
+    c <<= 1;
+  return c;
+}
+
+/* Bucket holding hash h. While an incremental resize runs, old buckets
+   that have not been migrated yet still own their entries. */
+static ht_entry** ht_bucket(const hash_table* ht, const size_t h) {
+  if (ht->old_buckets) {
+    size_t old_idx = h & (ht->old_capacity - 1);
+    if (old_idx >= ht->migrate_pos)
+      return &ht->old_buckets[old_idx];
+  }
+  return &ht->buckets[h & (ht->capacity - 1)];
+}
+
+/* Default allocator: entries come from a slab pool owned by the table */
+static void* ht_slab_alloc(void* ctx, size_t size) {
+  (void)size; /* always sizeof(ht_entry) */
+  return slab_alloc(ctx);
+}
+
+static void ht_slab_free(void* ctx, void* ptr) {
+  slab_free(ctx, ptr);
+}
+
+static void ht_slab_release(void* ctx) {
+  slab_destroy(ctx);
+}
+
+/* Frees a chain. Entry memory itself is left to the allocator's bulk
+   release if it has one. */
+static void ht_free_chain(hash_table* ht, ht_entry* e) {
+  if (!ht->free_key && !ht->free_value && ht->alloc.release)
+    return;
+  while (e) {
+    ht_entry* next = e->next;
+    if (ht->free_key)
+      ht->free_key(e->key);
+    if (ht->free_value)
+      ht->free_value(e->value);
+    if (!ht->alloc.release)
+      ht->alloc.free(ht->alloc.ctx, e);
+    e = next;
+  }
+}
 
 hash_table* ht_create(const size_t capacity,
                       hash_func hash,
                       key_eq_func key_eq,
                       ht_free_func free_key,
                       ht_free_func free_value) {
-  size_t c = (capacity == 0 ? HT_INITIAL_CAPACITY : capacity);
+  return ht_create_with_allocator(capacity, hash, key_eq, free_key,
+                                  free_value, NULL);
+}
+
+hash_table* ht_create_with_allocator(const size_t capacity,
+                                     hash_func hash,
+                                     key_eq_func key_eq,
+                                     ht_free_func free_key,
+                                     ht_free_func free_value,
+                                     const ht_allocator* alloc) {
+  size_t c = ht_round_capacity(capacity == 0 ? HT_INITIAL_CAPACITY : capacity);
   hash_table* ht = malloc(sizeof(hash_table));
   if (!ht)
     return NULL;
+  if (alloc) {
+    ht->alloc = *alloc;
+  } else {
+    slab_pool* pool = slab_create(sizeof(ht_entry), SLAB_DEFAULT_OBJECTS);
+    if (!pool) {
+      free(ht);
+      return NULL;
+    }
+    ht->alloc =
+        (ht_allocator){ht_slab_alloc, ht_slab_free, ht_slab_release, pool};
+  }
   ht->capacity = c;
   ht->size = 0;
   ht->hash = hash;
   ht->key_eq = key_eq;
   ht->buckets = calloc(c, sizeof(ht_entry*));
+  ht->old_buckets = NULL;
+  ht->old_capacity = 0;
+  ht->migrate_pos = 0;
+  ht->incremental = 0;
   ht->free_key = free_key;
   ht->free_value = free_value;
+#ifdef CONTAINER_STATS
+  memset(&ht->stats, 0, sizeof(ht->stats));
+#endif
   return ht;
 }
 
 void ht_destroy(hash_table* ht) {
-  for (size_t i = 0; i < ht->capacity; i++) {
-    ht_entry* e = ht->buckets[i];
-    while (e) {
-      ht_entry* next = e->next;
-      if (ht->free_key)
-        ht->free_key(e->key);
-      if (ht->free_value)
-        ht->free_value(e->value);
-      free(e);
-      e = next;
-    }
+  if (ht->old_buckets) {
+    for (size_t i = ht->migrate_pos; i < ht->old_capacity; i++)
+      ht_free_chain(ht, ht->old_buckets[i]);
+    free(ht->old_buckets);
   }
+  for (size_t i = 0; i < ht->capacity; i++)
+    ht_free_chain(ht, ht->buckets[i]);
+  if (ht->alloc.release)
+    ht->alloc.release(ht->alloc.ctx);
   free(ht->buckets);
   free(ht);
 }
 
+void ht_set_incremental(hash_table* ht, const int enable) {
+  if (!ht)
+    return;
+  /* Leaving incremental mode completes a running migration */
+  if (!enable && ht->old_buckets)
+    ht_rehash_step(ht, ht->old_capacity);
+  ht->incremental = enable;
+}
+
 int ht_insert(hash_table* ht, void* key, void* value) {
+  if (ht->old_buckets)
+    ht_rehash_step(ht, HT_REHASH_STEP);
   double load = (double)ht->size / ht->capacity;
   if (load > HT_MAX_LOAD_FACTOR) {
     if (ht_resize(ht, ht->capacity * 2) != 0)
       return -1;
   }
-  size_t idx = ht->hash(key) % ht->capacity;
-  ht_entry* e = ht->buckets[idx];
+  size_t h = ht_mix(ht->hash(key));
+  ht_entry** bucket = ht_bucket(ht, h);
+  ht_entry* e = *bucket;
+  size_t walked = 0;
   while (e) {
-    if (ht->key_eq(e->key, key)) {
+    walked++;
+    if (e->hash == h && ht->key_eq(e->key, key)) {
+      ht_stat_chain(ht, walked);
       if (ht->free_key)
         ht->free_key(key);
       if (ht->free_value)
@@ -60,49 +169,106 @@ int ht_insert(hash_table* ht, void* key, void* value) {
     }
     e = e->next;
   }
-  ht_entry* new_entry = malloc(sizeof(ht_entry));
+  ht_stat_chain(ht, walked);
+  ht_entry* new_entry = ht->alloc.alloc(ht->alloc.ctx, sizeof(ht_entry));
   if (!new_entry)
     return -1;
   new_entry->key = key;
   new_entry->value = value;
-  new_entry->next = ht->buckets[idx];
-  ht->buckets[idx] = new_entry;
+  new_entry->hash = h;
+  new_entry->next = *bucket;
+  *bucket = new_entry;
   ht->size++;
   return 0;
 }
 
 void* ht_get(const hash_table* ht, const void* key) {
-  size_t idx = ht->hash(key) % ht->capacity;
-  ht_entry* e = ht->buckets[idx];
+  size_t h = ht_mix(ht->hash(key));
+  ht_entry* e = *ht_bucket(ht, h);
+  size_t walked = 0;
   while (e) {
-    if (ht->key_eq(e->key, key))
+    walked++;
+    if (e->hash == h && ht->key_eq(e->key, key)) {
+      ht_stat_chain(ht, walked);
       return e->value;
+    }
     e = e->next;
   }
+  ht_stat_chain(ht, walked);
   return NULL;
 }
 
+/* Looks up n keys, storing each value (or NULL) in out_values, and returns
+   how many were found. Keys are handled in batches: all of a batch are
+   hashed and their buckets prefetched, then the first entries are
+   prefetched, and only then are the chains walked, so the cache misses of
+   a batch overlap instead of being paid one after another. */
+size_t ht_get_many(const hash_table* ht,
+                   const void* const* keys,
+                   const size_t n,
+                   void** out_values) {
+  size_t hashes[HT_GET_BATCH];
+  ht_entry** slots[HT_GET_BATCH];
+  ht_entry* heads[HT_GET_BATCH];
+  size_t found = 0;
+  for (size_t base = 0; base < n; base += HT_GET_BATCH) {
+    size_t count = n - base < HT_GET_BATCH ? n - base : HT_GET_BATCH;
+    for (size_t i = 0; i < count; i++) {
+      hashes[i] = ht_mix(ht->hash(keys[base + i]));
+      slots[i] = ht_bucket(ht, hashes[i]);
+      __builtin_prefetch(slots[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+      heads[i] = *slots[i];
+      if (heads[i])
+        __builtin_prefetch(heads[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+      void* value = NULL;
+      size_t walked = 0;
+      for (ht_entry* e = heads[i]; e; e = e->next) {
+        walked++;
+        if (e->hash == hashes[i] && ht->key_eq(e->key, keys[base + i])) {
+          value = e->value;
+          found++;
+          break;
+        }
+      }
+      ht_stat_chain(ht, walked);
+      out_values[base + i] = value;
+    }
+  }
+  return found;
+}
+
 int ht_remove(hash_table* ht, const void* key) {
-  size_t idx = ht->hash(key) % ht->capacity;
-  ht_entry* e = ht->buckets[idx];
+  if (ht->old_buckets)
+    ht_rehash_step(ht, HT_REHASH_STEP);
+  size_t h = ht_mix(ht->hash(key));
+  ht_entry** bucket = ht_bucket(ht, h);
+  ht_entry* e = *bucket;
   ht_entry* prev = NULL;
+  size_t walked = 0;
   while (e) {
-    if (ht->key_eq(e->key, key)) {
+    walked++;
+    if (e->hash == h && ht->key_eq(e->key, key)) {
+      ht_stat_chain(ht, walked);
       if (prev)
         prev->next = e->next;
       else
-        ht->buckets[idx] = e->next;
+        *bucket = e->next;
       if (ht->free_key)
         ht->free_key(e->key);
       if (ht->free_value)
         ht->free_value(e->value);
-      free(e);
+      ht->alloc.free(ht->alloc.ctx, e);
       ht->size--;
       return 0;
     }
     prev = e;
     e = e->next;
   }
+  ht_stat_chain(ht, walked);
   return -1;
 }
 
@@ -113,31 +279,43 @@ void ht_foreach(const hash_table* ht,
   if (!ht || !func)
     return;
   size_t count = 0;
-  for (size_t i = 0; i < ht->capacity; i++) {
-    ht_entry* e = ht->buckets[i];
-    while (e) {
-      func(e->key, e->value, user_data);
-      count++;
-      if (limit != 0)
-        if (count >= limit)
-          return;
-      e = e->next;
+  /* During a migration, entries are spread over both bucket arrays */
+  for (int pass = 0; pass < 2; pass++) {
+    ht_entry** buckets = pass == 0 ? ht->old_buckets : ht->buckets;
+    size_t from = pass == 0 ? ht->migrate_pos : 0;
+    size_t to = pass == 0 ? ht->old_capacity : ht->capacity;
+    if (!buckets)
+      continue;
+    for (size_t i = from; i < to; i++) {
+      ht_entry* e = buckets[i];
+      while (e) {
+        func(e->key, e->value, user_data);
+        count++;
+        if (limit != 0)
+          if (count >= limit)
+            return;
+        e = e->next;
+      }
     }
   }
 }
 
 static int ht_resize(hash_table* ht, const size_t new_capacity) {
+  HT_STAT_ADD(ht, resizes, 1);
+  if (ht->incremental)
+    return ht_resize_begin(ht, new_capacity);
   ht_entry** new_buckets = calloc(new_capacity, sizeof(ht_entry*));
   if (!new_buckets)
     return -1;
-  /* Rehash all entries */
+  /* Redistribute all entries using their cached hashes */
   for (size_t i = 0; i < ht->capacity; i++) {
     ht_entry* e = ht->buckets[i];
     while (e) {
       ht_entry* next = e->next;
-      size_t idx = ht->hash(e->key) % new_capacity;
+      size_t idx = e->hash & (new_capacity - 1);
       e->next = new_buckets[idx];
       new_buckets[idx] = e;
+      HT_STAT_ADD(ht, rehashed, 1);
       e = next;
     }
   }
@@ -147,6 +325,61 @@ static int ht_resize(hash_table* ht, const size_t new_capacity) {
   return 0;
 }
 
+/* Starts an incremental resize: the current buckets become the old array
+   and are moved over a few at a time by ht_rehash_step */
+static int ht_resize_begin(hash_table* ht, const size_t new_capacity) {
+  /* A migration still running when the next one is due is finished first.
+     With HT_REHASH_STEP of 2 or more that cannot happen (make check
+     verifies it), so this is no hidden O(n) step. */
+  if (ht->old_buckets)
+    ht_rehash_step(ht, ht->old_capacity);
+  ht_entry** new_buckets = calloc(new_capacity, sizeof(ht_entry*));
+  if (!new_buckets)
+    return -1;
+  ht->old_buckets = ht->buckets;
+  ht->old_capacity = ht->capacity;
+  ht->migrate_pos = 0;
+  ht->buckets = new_buckets;
+  ht->capacity = new_capacity;
+  return 0;
+}
+
+/* Moves up to the given number of old buckets into the new array */
+static void ht_rehash_step(hash_table* ht, size_t buckets) {
+  while (buckets-- > 0 && ht->migrate_pos < ht->old_capacity) {
+    ht_entry* e = ht->old_buckets[ht->migrate_pos];
+    ht->old_buckets[ht->migrate_pos] = NULL;
+    ht->migrate_pos++;
+    while (e) {
+      ht_entry* next = e->next;
+      size_t idx = e->hash & (ht->capacity - 1);
+      e->next = ht->buckets[idx];
+      ht->buckets[idx] = e;
+      HT_STAT_ADD(ht, rehashed, 1);
+      e = next;
+    }
+  }
+  if (ht->migrate_pos == ht->old_capacity) {
+    free(ht->old_buckets);
+    ht->old_buckets = NULL;
+    ht->old_capacity = 0;
+    ht->migrate_pos = 0;
+  }
+}
+
 size_t ht_size(const hash_table* ht) {
   return ht ? ht->size : 0;
 }
+
+/* Counters since ht_create; all zero unless built with CONTAINER_STATS */
+ht_statistics ht_stats(const hash_table* ht) {
+  ht_statistics s;
+  memset(&s, 0, sizeof(s));
+#ifdef CONTAINER_STATS
+  if (ht)
+    s = ht->stats;
+#else
+  (void)ht; /* unused */
+#endif
+  return s;
+}
@@ -2,9 +2,21 @@
 #define HASHTABLE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #define HT_MAX_LOAD_FACTOR 0.75
 #define HT_INITIAL_CAPACITY 1024
+/* Old buckets migrated per insert/remove in incremental mode. A migration
+   of C buckets ends within C/4 writes, before the 0.75 C more entries the
+   next resize needs, so no insert has to finish one. What remains per
+   resize is one insert allocating the doubled bucket array, and the write
+   that ends the migration freeing the old one: one allocator call each,
+   up to tens of microseconds for large tables. */
+#define HT_REHASH_STEP 4
+/* Keys hashed and prefetched together by ht_get_many */
+#define HT_GET_BATCH 32
+/* Chain length histogram buckets, the last one counts longer chains too */
+#define HT_STATS_CHAIN 16
 
 /* Function pointer types */
 typedef size_t (*hash_func)(const void* key);
@@ -14,22 +26,61 @@ typedef void (*ht_iter_func)(const void* key,
                              const void* value,
                              void* user_data);
 
+/* Entry allocator, ctx is passed to every call. If release is set,
+   ht_destroy hands all entries back at once instead of freeing each. */
+typedef struct ht_allocator {
+  void* (*alloc)(void* ctx, size_t size);
+  void (*free)(void* ctx, void* ptr);
+  void (*release)(void* ctx);
+  void* ctx;
+} ht_allocator;
+
+/* Final mixing step (64-bit murmur finalizer) applied to every user hash
+   by all the tables, so weak hashes spread over the masked low bits */
+static inline size_t ht_mix(size_t h) {
+  uint64_t x = (uint64_t)h;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  return (size_t)x;
+}
+
 /* Hash table entry */
 typedef struct ht_entry {
   void* key;
   void* value;
+  size_t hash; /* cached (mixed) hash of key */
   struct ht_entry* next;
 } ht_entry;
 
+/* Counters kept when built with CONTAINER_STATS (see ht_stats). Lookups
+   are counted by ht_insert, ht_get, ht_get_many and ht_remove;
+   chain[i] counts those that walked i entries. The counters are not
+   synchronised, so concurrent readers may lose some. */
+typedef struct ht_statistics {
+  size_t lookups;
+  size_t chain[HT_STATS_CHAIN];
+  size_t resizes;  /* ht_resize calls, incremental ones included */
+  size_t rehashed; /* entries moved into a new bucket array */
+} ht_statistics;
+
 /* Hash table */
 typedef struct hash_table {
   size_t capacity;
   size_t size;
   ht_entry** buckets;
+  ht_entry** old_buckets; /* non-NULL while an incremental resize runs */
+  size_t old_capacity;
+  size_t migrate_pos; /* old buckets below this index are migrated */
+  int incremental;
+  ht_allocator alloc;
   hash_func hash;
   key_eq_func key_eq;
   ht_free_func free_key;
   ht_free_func free_value;
+#ifdef CONTAINER_STATS
+  ht_statistics stats;
+#endif
 } hash_table;
 
 /* API */
@@ -38,14 +89,30 @@ hash_table* ht_create(const size_t capacity,
                       key_eq_func key_eq,
                       ht_free_func free_key,
                       ht_free_func free_value);
+hash_table* ht_create_with_allocator(const size_t capacity,
+                                     hash_func hash,
+                                     key_eq_func key_eq,
+                                     ht_free_func free_key,
+                                     ht_free_func free_value,
+                                     const ht_allocator* alloc);
 void ht_destroy(hash_table* ht);
+/* In incremental mode only writes advance a migration: each ht_insert and
+   ht_remove moves HT_REHASH_STEP old buckets. Lookups and ht_foreach take a
+   const table and never do, so until enough writes come they keep checking
+   both bucket arrays. */
+void ht_set_incremental(hash_table* ht, const int enable);
 int ht_insert(hash_table* ht, void* key, void* value);
 void* ht_get(const hash_table* ht, const void* key);
+size_t ht_get_many(const hash_table* ht,
+                   const void* const* keys,
+                   const size_t n,
+                   void** out_values);
 int ht_remove(hash_table* ht, const void* key);
 void ht_foreach(const hash_table* ht,
                 ht_iter_func func,
                 const size_t limit,
                 void* user_data);
 size_t ht_size(const hash_table* ht);
+ht_statistics ht_stats(const hash_table* ht);
 
 #endif
@@ -0,0 +1,220 @@
+#include "hashtable_concurrent.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+/* Internal Helpers */
+static int cht_segment_resize(cht_segment* seg, const size_t new_capacity);
+
+/* The top byte picks the stripe, the low bits the bucket inside it */
+static cht_segment* cht_segment_for(const cht_table* cht, const size_t h) {
+  size_t top = h >> (sizeof(size_t) * CHAR_BIT - 8);
+  return &cht->segments[top & (CHT_STRIPES - 1)];
+}
+
+static void cht_segment_clear(cht_table* cht, cht_segment* seg) {
+  if (cht->free_key || cht->free_value) {
+    for (size_t i = 0; i < seg->capacity; i++) {
+      for (ht_entry* e = seg->buckets[i]; e; e = e->next) {
+        if (cht->free_key)
+          cht->free_key(e->key);
+        if (cht->free_value)
+          cht->free_value(e->value);
+      }
+    }
+  }
+  slab_destroy(seg->pool);
+  free(seg->buckets);
+  pthread_rwlock_destroy(&seg->lock);
+}
+
+cht_table* cht_create(const size_t capacity,
+                      hash_func hash,
+                      key_eq_func key_eq,
+                      ht_free_func free_key,
+                      ht_free_func free_value) {
+  size_t per_segment =
+      (capacity == 0 ? HT_INITIAL_CAPACITY : capacity) / CHT_STRIPES;
+  size_t c = 16;
+  while (c < per_segment)
+    c <<= 1;
+  cht_table* cht = malloc(sizeof(cht_table));
+  if (!cht)
+    return NULL;
+  cht->segments =
+      aligned_alloc(CHT_CACHE_LINE, CHT_STRIPES * sizeof(cht_segment));
+  if (!cht->segments) {
+    free(cht);
+    return NULL;
+  }
+  cht->hash = hash;
+  cht->key_eq = key_eq;
+  cht->free_key = free_key;
+  cht->free_value = free_value;
+  for (size_t i = 0; i < CHT_STRIPES; i++) {
+    cht_segment* seg = &cht->segments[i];
+    seg->buckets = calloc(c, sizeof(ht_entry*));
+    seg->pool = slab_create(sizeof(ht_entry), SLAB_DEFAULT_OBJECTS);
+    if (!seg->buckets || !seg->pool ||
+        pthread_rwlock_init(&seg->lock, NULL) != 0) {
+      free(seg->buckets);
+      slab_destroy(seg->pool);
+      for (size_t j = 0; j < i; j++)
+        cht_segment_clear(cht, &cht->segments[j]);
+      free(cht->segments);
+      free(cht);
+      return NULL;
+    }
+    seg->capacity = c;
+    seg->size = 0;
+  }
+  return cht;
+}
+
+void cht_destroy(cht_table* cht) {
+  if (!cht)
+    return;
+  for (size_t i = 0; i < CHT_STRIPES; i++)
+    cht_segment_clear(cht, &cht->segments[i]);
+  free(cht->segments);
+  free(cht);
+}
+
+int cht_insert(cht_table* cht, void* key, void* value) {
+  size_t h = ht_mix(cht->hash(key));
+  cht_segment* seg = cht_segment_for(cht, h);
+  pthread_rwlock_wrlock(&seg->lock);
+  if ((double)seg->size / seg->capacity > HT_MAX_LOAD_FACTOR) {
+    if (cht_segment_resize(seg, seg->capacity * 2) != 0) {
+      pthread_rwlock_unlock(&seg->lock);
+      return -1;
+    }
+  }
+  size_t idx = h & (seg->capacity - 1);
+  for (ht_entry* e = seg->buckets[idx]; e; e = e->next) {
+    if (e->hash == h && cht->key_eq(e->key, key)) {
+      void* old = e->value;
+      e->value = value;
+      pthread_rwlock_unlock(&seg->lock);
+      if (cht->free_key)
+        cht->free_key(key);
+      if (cht->free_value)
+        cht->free_value(old);
+      return 0;
+    }
+  }
+  ht_entry* new_entry = slab_alloc(seg->pool);
+  if (!new_entry) {
+    pthread_rwlock_unlock(&seg->lock);
+    return -1;
+  }
+  new_entry->key = key;
+  new_entry->value = value;
+  new_entry->hash = h;
+  new_entry->next = seg->buckets[idx];
+  seg->buckets[idx] = new_entry;
+  seg->size++;
+  pthread_rwlock_unlock(&seg->lock);
+  return 0;
+}
+
+void* cht_get(cht_table* cht, const void* key) {
+  size_t h = ht_mix(cht->hash(key));
+  cht_segment* seg = cht_segment_for(cht, h);
+  void* value = NULL;
+  pthread_rwlock_rdlock(&seg->lock);
+  for (ht_entry* e = seg->buckets[h & (seg->capacity - 1)]; e; e = e->next) {
+    if (e->hash == h && cht->key_eq(e->key, key)) {
+      value = e->value;
+      break;
+    }
+  }
+  pthread_rwlock_unlock(&seg->lock);
+  return value;
+}
+
+int cht_remove(cht_table* cht, const void* key) {
+  size_t h = ht_mix(cht->hash(key));
+  cht_segment* seg = cht_segment_for(cht, h);
+  pthread_rwlock_wrlock(&seg->lock);
+  ht_entry** link = &seg->buckets[h & (seg->capacity - 1)];
+  while (*link) {
+    ht_entry* e = *link;
+    if (e->hash == h && cht->key_eq(e->key, key)) {
+      void* old_key = e->key;
+      void* old_value = e->value;
+      *link = e->next;
+      slab_free(seg->pool, e);
+      seg->size--;
+      pthread_rwlock_unlock(&seg->lock);
+      /* User hooks run outside the lock */
+      if (cht->free_key)
+        cht->free_key(old_key);
+      if (cht->free_value)
+        cht->free_value(old_value);
+      return 0;
+    }
+    link = &e->next;
+  }
+  pthread_rwlock_unlock(&seg->lock);
+  return -1;
+}
+
+void cht_foreach(cht_table* cht,
+                 ht_iter_func func,
+                 const size_t limit,
+                 void* user_data) {
+  if (!cht || !func)
+    return;
+  size_t count = 0;
+  /* Each stripe is visited under its read lock; the walk as a whole is
+     not a snapshot of the table */
+  for (size_t s = 0; s < CHT_STRIPES; s++) {
+    cht_segment* seg = &cht->segments[s];
+    pthread_rwlock_rdlock(&seg->lock);
+    for (size_t i = 0; i < seg->capacity; i++) {
+      for (ht_entry* e = seg->buckets[i]; e; e = e->next) {
+        func(e->key, e->value, user_data);
+        count++;
+        if (limit != 0 && count >= limit) {
+          pthread_rwlock_unlock(&seg->lock);
+          return;
+        }
+      }
+    }
+    pthread_rwlock_unlock(&seg->lock);
+  }
+}
+
+/* Called with the stripe's write lock held */
+static int cht_segment_resize(cht_segment* seg, const size_t new_capacity) {
+  ht_entry** new_buckets = calloc(new_capacity, sizeof(ht_entry*));
+  if (!new_buckets)
+    return -1;
+  for (size_t i = 0; i < seg->capacity; i++) {
+    ht_entry* e = seg->buckets[i];
+    while (e) {
+      ht_entry* next = e->next;
+      size_t idx = e->hash & (new_capacity - 1);
+      e->next = new_buckets[idx];
+      new_buckets[idx] = e;
+      e = next;
+    }
+  }
+  free(seg->buckets);
+  seg->buckets = new_buckets;
+  seg->capacity = new_capacity;
+  return 0;
+}
+
+size_t cht_size(cht_table* cht) {
+  if (!cht)
+    return 0;
+  size_t size = 0;
+  for (size_t i = 0; i < CHT_STRIPES; i++) {
+    pthread_rwlock_rdlock(&cht->segments[i].lock);
+    size += cht->segments[i].size;
+    pthread_rwlock_unlock(&cht->segments[i].lock);
+  }
+  return size;
+}
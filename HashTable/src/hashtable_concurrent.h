@@ -0,0 +1,52 @@
+#ifndef HASHTABLE_CONCURRENT_H
+#define HASHTABLE_CONCURRENT_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "hashtable.h"
+#include "slab.h"
+
+/* Number of lock stripes, a power of two */
+#define CHT_STRIPES 64
+#define CHT_CACHE_LINE 64
+
+/* One lock stripe: an independent chained table behind a rwlock. Each
+   stripe resizes on its own, so growing never blocks the other stripes. */
+typedef struct cht_segment {
+  _Alignas(CHT_CACHE_LINE) pthread_rwlock_t lock;
+  ht_entry** buckets;
+  size_t capacity; /* power of two */
+  size_t size;
+  slab_pool* pool; /* entry storage, guarded by lock */
+} cht_segment;
+
+/* Concurrent hash table */
+typedef struct cht_table {
+  cht_segment* segments;
+  hash_func hash;
+  key_eq_func key_eq;
+  ht_free_func free_key;
+  ht_free_func free_value;
+} cht_table;
+
+/* API
+   All functions may be called from any number of threads. cht_get runs
+   in parallel with other readers; a value it returns stays valid only
+   until another thread replaces or removes that key. */
+cht_table* cht_create(const size_t capacity,
+                      hash_func hash,
+                      key_eq_func key_eq,
+                      ht_free_func free_key,
+                      ht_free_func free_value);
+void cht_destroy(cht_table* cht);
+int cht_insert(cht_table* cht, void* key, void* value);
+void* cht_get(cht_table* cht, const void* key);
+int cht_remove(cht_table* cht, const void* key);
+void cht_foreach(cht_table* cht,
+                 ht_iter_func func,
+                 const size_t limit,
+                 void* user_data);
+size_t cht_size(cht_table* cht);
+
+#endif
@@ -0,0 +1,247 @@
+#include "hashtable_oa.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Internal Helpers */
+static int oa_rehash(oa_table* oa, const size_t new_capacity);
+
+/* Low 7 bits of the hash, stored in the control byte of a full slot */
+static uint8_t oa_h2(const size_t h) {
+  return (uint8_t)(h & 0x7F);
+}
+
+/* Group probed first, from the remaining hash bits */
+static size_t oa_h1(const size_t h) {
+  return h >> 7;
+}
+
+static size_t oa_round_capacity(const size_t capacity) {
+  size_t c = OA_GROUP_WIDTH;
+  while (c < capacity)
+    c <<= 1;
+  return c;
+}
+
+/* Bit i of the result is set if ctrl[i] == b */
+static unsigned oa_group_match(const uint8_t* ctrl, const uint8_t b) {
+#ifdef __SSE2__
+  __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+  __m128i match = _mm_cmpeq_epi8(group, _mm_set1_epi8((char)b));
+  return (unsigned)_mm_movemask_epi8(match);
+#else
+  unsigned mask = 0;
+  for (unsigned i = 0; i < OA_GROUP_WIDTH; i++)
+    if (ctrl[i] == b)
+      mask |= 1u << i;
+  return mask;
+#endif
+}
+
+/* Bit i of the result is set if slot i is empty or deleted */
+static unsigned oa_group_match_free(const uint8_t* ctrl) {
+#ifdef __SSE2__
+  __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+  return (unsigned)_mm_movemask_epi8(group);
+#else
+  unsigned mask = 0;
+  for (unsigned i = 0; i < OA_GROUP_WIDTH; i++)
+    if (ctrl[i] & 0x80)
+      mask |= 1u << i;
+  return mask;
+#endif
+}
+
+static unsigned oa_lowest_bit(const unsigned mask) {
+  return (unsigned)__builtin_ctz(mask);
+}
+
+/* Returns the slot index holding key, or capacity if not found */
+static size_t oa_find(const oa_table* oa, const void* key, const size_t h) {
+  size_t groups_mask = oa->capacity / OA_GROUP_WIDTH - 1;
+  size_t g = oa_h1(h) & groups_mask;
+  uint8_t tag = oa_h2(h);
+  /* Triangular probing over groups visits every group once */
+  for (size_t step = 1; step <= groups_mask + 1; step++) {
+    const uint8_t* ctrl = oa->ctrl + g * OA_GROUP_WIDTH;
+    unsigned mask = oa_group_match(ctrl, tag);
+    while (mask) {
+      size_t idx = g * OA_GROUP_WIDTH + oa_lowest_bit(mask);
+      if (oa->key_eq(oa->slots[idx].key, key))
+        return idx;
+      mask &= mask - 1;
+    }
+    if (oa_group_match(ctrl, OA_CTRL_EMPTY))
+      break; /* an empty slot ends the probe sequence */
+    g = (g + step) & groups_mask;
+  }
+  return oa->capacity;
+}
+
+/* Returns the first empty or deleted slot on the probe sequence of h */
+static size_t oa_find_free(const oa_table* oa, const size_t h) {
+  size_t groups_mask = oa->capacity / OA_GROUP_WIDTH - 1;
+  size_t g = oa_h1(h) & groups_mask;
+  for (size_t step = 1;; step++) {
+    unsigned mask = oa_group_match_free(oa->ctrl + g * OA_GROUP_WIDTH);
+    if (mask)
+      return g * OA_GROUP_WIDTH + oa_lowest_bit(mask);
+    g = (g + step) & groups_mask;
+  }
+}
+
+oa_table* oa_create(const size_t capacity,
+                    hash_func hash,
+                    key_eq_func key_eq,
+                    ht_free_func free_key,
+                    ht_free_func free_value) {
+  size_t c = oa_round_capacity(capacity == 0 ? OA_INITIAL_CAPACITY : capacity);
+  oa_table* oa = malloc(sizeof(oa_table));
+  if (!oa)
+    return NULL;
+  oa->ctrl = malloc(c);
+  oa->slots = malloc(c * sizeof(oa_slot));
+  if (!oa->ctrl || !oa->slots) {
+    free(oa->ctrl);
+    free(oa->slots);
+    free(oa);
+    return NULL;
+  }
+  memset(oa->ctrl, OA_CTRL_EMPTY, c);
+  oa->capacity = c;
+  oa->size = 0;
+  oa->deleted = 0;
+  oa->hash = hash;
+  oa->key_eq = key_eq;
+  oa->free_key = free_key;
+  oa->free_value = free_value;
+  return oa;
+}
+
+void oa_destroy(oa_table* oa) {
+  if (!oa)
+    return;
+  for (size_t i = 0; i < oa->capacity; i++) {
+    if (oa->ctrl[i] & 0x80)
+      continue;
+    if (oa->free_key)
+      oa->free_key(oa->slots[i].key);
+    if (oa->free_value)
+      oa->free_value(oa->slots[i].value);
+  }
+  free(oa->ctrl);
+  free(oa->slots);
+  free(oa);
+}
+
+int oa_insert(oa_table* oa, void* key, void* value) {
+  size_t h = ht_mix(oa->hash(key));
+  size_t idx = oa_find(oa, key, h);
+  if (idx < oa->capacity) {
+    if (oa->free_key)
+      oa->free_key(key);
+    if (oa->free_value)
+      oa->free_value(oa->slots[idx].value);
+    oa->slots[idx].value = value;
+    return 0;
+  }
+  if ((oa->size + oa->deleted + 1) * OA_MAX_LOAD_DEN >
+      oa->capacity * OA_MAX_LOAD_NUM) {
+    /* Grow if live entries fill half the limit, else just drop tombstones */
+    size_t c = oa->capacity;
+    if ((oa->size + 1) * OA_MAX_LOAD_DEN * 2 > c * OA_MAX_LOAD_NUM)
+      c *= 2;
+    if (oa_rehash(oa, c) != 0)
+      return -1;
+  }
+  idx = oa_find_free(oa, h);
+  if (oa->ctrl[idx] == OA_CTRL_DELETED)
+    oa->deleted--;
+  oa->ctrl[idx] = oa_h2(h);
+  oa->slots[idx].key = key;
+  oa->slots[idx].value = value;
+  oa->size++;
+  return 0;
+}
+
+void* oa_get(const oa_table* oa, const void* key) {
+  size_t idx = oa_find(oa, key, ht_mix(oa->hash(key)));
+  return idx < oa->capacity ? oa->slots[idx].value : NULL;
+}
+
+int oa_remove(oa_table* oa, const void* key) {
+  size_t idx = oa_find(oa, key, ht_mix(oa->hash(key)));
+  if (idx == oa->capacity)
+    return -1;
+  if (oa->free_key)
+    oa->free_key(oa->slots[idx].key);
+  if (oa->free_value)
+    oa->free_value(oa->slots[idx].value);
+  /* A group that still has an empty slot never ended a probe sequence,
+     so the slot can become empty again instead of a tombstone */
+  const uint8_t* group = oa->ctrl + (idx & ~(size_t)(OA_GROUP_WIDTH - 1));
+  if (oa_group_match(group, OA_CTRL_EMPTY)) {
+    oa->ctrl[idx] = OA_CTRL_EMPTY;
+  } else {
+    oa->ctrl[idx] = OA_CTRL_DELETED;
+    oa->deleted++;
+  }
+  oa->size--;
+  return 0;
+}
+
+void oa_foreach(const oa_table* oa,
+                ht_iter_func func,
+                const size_t limit,
+                void* user_data) {
+  if (!oa || !func)
+    return;
+  size_t count = 0;
+  for (size_t i = 0; i < oa->capacity; i++) {
+    if (oa->ctrl[i] & 0x80)
+      continue;
+    func(oa->slots[i].key, oa->slots[i].value, user_data);
+    count++;
+    if (limit != 0)
+      if (count >= limit)
+        return;
+  }
+}
+
+static int oa_rehash(oa_table* oa, const size_t new_capacity) {
+  uint8_t* new_ctrl = malloc(new_capacity);
+  oa_slot* new_slots = malloc(new_capacity * sizeof(oa_slot));
+  if (!new_ctrl || !new_slots) {
+    free(new_ctrl);
+    free(new_slots);
+    return -1;
+  }
+  memset(new_ctrl, OA_CTRL_EMPTY, new_capacity);
+  uint8_t* old_ctrl = oa->ctrl;
+  oa_slot* old_slots = oa->slots;
+  size_t old_capacity = oa->capacity;
+  oa->ctrl = new_ctrl;
+  oa->slots = new_slots;
+  oa->capacity = new_capacity;
+  oa->deleted = 0;
+  /* Reinsert all live entries */
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old_ctrl[i] & 0x80)
+      continue;
+    size_t h = ht_mix(oa->hash(old_slots[i].key));
+    size_t idx = oa_find_free(oa, h);
+    oa->ctrl[idx] = oa_h2(h);
+    oa->slots[idx] = old_slots[i];
+  }
+  free(old_ctrl);
+  free(old_slots);
+  return 0;
+}
+
+size_t oa_size(const oa_table* oa) {
+  return oa ? oa->size : 0;
+}
@@ -0,0 +1,54 @@
+#ifndef HASHTABLE_OA_H
+#define HASHTABLE_OA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hashtable.h"
+
+/* Slots are probed in groups of OA_GROUP_WIDTH control bytes */
+#define OA_GROUP_WIDTH 16
+#define OA_MAX_LOAD_NUM 7
+#define OA_MAX_LOAD_DEN 8
+#define OA_INITIAL_CAPACITY 1024
+
+/* Control byte values; full slots store the low 7 bits of the hash */
+#define OA_CTRL_EMPTY ((uint8_t)0x80)
+#define OA_CTRL_DELETED ((uint8_t)0xFE)
+
+/* Open addressing slot */
+typedef struct oa_slot {
+  void* key;
+  void* value;
+} oa_slot;
+
+/* Open addressing hash table */
+typedef struct oa_table {
+  size_t capacity; /* power of two, multiple of OA_GROUP_WIDTH */
+  size_t size;
+  size_t deleted;
+  uint8_t* ctrl; /* one control byte per slot */
+  oa_slot* slots;
+  hash_func hash;
+  key_eq_func key_eq;
+  ht_free_func free_key;
+  ht_free_func free_value;
+} oa_table;
+
+/* API */
+oa_table* oa_create(const size_t capacity,
+                    hash_func hash,
+                    key_eq_func key_eq,
+                    ht_free_func free_key,
+                    ht_free_func free_value);
+void oa_destroy(oa_table* oa);
+int oa_insert(oa_table* oa, void* key, void* value);
+void* oa_get(const oa_table* oa, const void* key);
+int oa_remove(oa_table* oa, const void* key);
+void oa_foreach(const oa_table* oa,
+                ht_iter_func func,
+                const size_t limit,
+                void* user_data);
+size_t oa_size(const oa_table* oa);
+
+#endif
@@ -0,0 +1,280 @@
+#include "hashtable_rcu.h"
+
+#include <stdlib.h>
+
+/* Internal Helpers */
+static int rht_resize(rht_table* rht, const size_t new_capacity);
+
+static rht_buckets* rht_buckets_new(const size_t capacity) {
+  rht_buckets* b =
+      malloc(sizeof(rht_buckets) + capacity * sizeof(_Atomic(rht_entry*)));
+  if (!b)
+    return NULL;
+  b->capacity = capacity;
+  for (size_t i = 0; i < capacity; i++)
+    atomic_init(&b->heads[i], NULL);
+  return b;
+}
+
+static void rht_free_entry(rht_table* rht, rht_entry* e) {
+  if (rht->free_key)
+    rht->free_key(e->key);
+  if (rht->free_value)
+    rht->free_value(e->value);
+  free(e);
+}
+
+/* Drops a reference; the last one frees the table */
+static void rht_unref(rht_table* rht) {
+  if (atomic_fetch_sub_explicit(&rht->refs, 1, memory_order_acq_rel) == 1) {
+    pthread_mutex_destroy(&rht->write_lock);
+    free(rht);
+  }
+}
+
+/* Reclamation callbacks, ctx is the table. Each retired entry holds a
+   reference, so rht_destroy does not have to wait for them. */
+static void rht_reclaim_entry(epoch_node* node, void* ctx) {
+  rht_free_entry(ctx, EPOCH_CONTAINER(node, rht_entry, retire));
+  rht_unref(ctx);
+}
+
+/* Replaced entry: its key lives on in the replacement */
+static void rht_reclaim_replaced(epoch_node* node, void* ctx) {
+  rht_table* rht = ctx;
+  rht_entry* e = EPOCH_CONTAINER(node, rht_entry, retire);
+  if (rht->free_value)
+    rht->free_value(e->value);
+  free(e);
+  rht_unref(rht);
+}
+
+static void rht_retire(rht_table* rht, rht_entry* e, epoch_free_func fn) {
+  atomic_fetch_add_explicit(&rht->refs, 1, memory_order_relaxed);
+  epoch_retire(&e->retire, fn, rht);
+}
+
+/* Old bucket array: keys and values were moved to the new array's copies */
+static void rht_free_buckets(rht_buckets* b) {
+  for (size_t i = 0; i < b->capacity; i++) {
+    rht_entry* e = atomic_load_explicit(&b->heads[i], memory_order_relaxed);
+    while (e) {
+      rht_entry* next = atomic_load_explicit(&e->next, memory_order_relaxed);
+      free(e);
+      e = next;
+    }
+  }
+  free(b);
+}
+
+static void rht_reclaim_buckets(epoch_node* node, void* ctx) {
+  (void)ctx; /* unused */
+  rht_free_buckets(EPOCH_CONTAINER(node, rht_buckets, retire));
+}
+
+/* Writer side lookup, with the write lock held. Returns the link that
+   points to the matching entry, or the terminating NULL link. */
+static _Atomic(rht_entry*)* rht_find_link(const rht_table* rht,
+                                          rht_buckets* b,
+                                          const void* key,
+                                          const size_t h) {
+  _Atomic(rht_entry*)* link = &b->heads[h & (b->capacity - 1)];
+  rht_entry* e;
+  while ((e = atomic_load_explicit(link, memory_order_relaxed))) {
+    if (e->hash == h && rht->key_eq(e->key, key))
+      return link;
+    link = &e->next;
+  }
+  return link;
+}
+
+rht_table* rht_create(const size_t capacity,
+                      hash_func hash,
+                      key_eq_func key_eq,
+                      ht_free_func free_key,
+                      ht_free_func free_value) {
+  size_t c = 1;
+  while (c < (capacity == 0 ? HT_INITIAL_CAPACITY : capacity))
+    c <<= 1;
+  rht_table* rht = malloc(sizeof(rht_table));
+  if (!rht)
+    return NULL;
+  rht_buckets* b = rht_buckets_new(c);
+  if (!b || pthread_mutex_init(&rht->write_lock, NULL) != 0) {
+    free(b);
+    free(rht);
+    return NULL;
+  }
+  atomic_init(&rht->buckets, b);
+  atomic_init(&rht->size, 0);
+  atomic_init(&rht->refs, 1);
+  rht->hash = hash;
+  rht->key_eq = key_eq;
+  rht->free_key = free_key;
+  rht->free_value = free_value;
+  return rht;
+}
+
+void rht_destroy(rht_table* rht) {
+  if (!rht)
+    return;
+  rht_buckets* b = atomic_load_explicit(&rht->buckets, memory_order_relaxed);
+  for (size_t i = 0; i < b->capacity; i++) {
+    rht_entry* e = atomic_load_explicit(&b->heads[i], memory_order_relaxed);
+    while (e) {
+      rht_entry* next = atomic_load_explicit(&e->next, memory_order_relaxed);
+      rht_free_entry(rht, e);
+      e = next;
+    }
+  }
+  free(b);
+  /* Entries still waiting for their grace period free the table later */
+  rht_unref(rht);
+}
+
+int rht_insert(rht_table* rht, void* key, void* value) {
+  size_t h = ht_mix(rht->hash(key));
+  pthread_mutex_lock(&rht->write_lock);
+  rht_buckets* b = atomic_load_explicit(&rht->buckets, memory_order_relaxed);
+  size_t size = atomic_load_explicit(&rht->size, memory_order_relaxed);
+  if ((double)size / b->capacity > HT_MAX_LOAD_FACTOR) {
+    if (rht_resize(rht, b->capacity * 2) != 0) {
+      pthread_mutex_unlock(&rht->write_lock);
+      return -1;
+    }
+    b = atomic_load_explicit(&rht->buckets, memory_order_relaxed);
+  }
+  _Atomic(rht_entry*)* link = rht_find_link(rht, b, key, h);
+  rht_entry* old = atomic_load_explicit(link, memory_order_relaxed);
+  rht_entry* e = malloc(sizeof(rht_entry));
+  if (!e) {
+    pthread_mutex_unlock(&rht->write_lock);
+    return -1;
+  }
+  e->value = value;
+  e->hash = h;
+  if (old) {
+    /* Readers see either the old or the new entry, never a torn one */
+    e->key = old->key;
+    atomic_init(&e->next,
+                atomic_load_explicit(&old->next, memory_order_relaxed));
+    atomic_store_explicit(link, e, memory_order_release);
+    pthread_mutex_unlock(&rht->write_lock);
+    if (rht->free_key)
+      rht->free_key(key);
+    rht_retire(rht, old, rht_reclaim_replaced);
+    return 0;
+  }
+  e->key = key;
+  atomic_init(&e->next, NULL);
+  atomic_store_explicit(link, e, memory_order_release);
+  atomic_store_explicit(&rht->size, size + 1, memory_order_relaxed);
+  pthread_mutex_unlock(&rht->write_lock);
+  return 0;
+}
+
+void* rht_get(const rht_table* rht, const void* key) {
+  size_t h = ht_mix(rht->hash(key));
+  void* value = NULL;
+  epoch_enter();
+  rht_buckets* b = atomic_load_explicit(&rht->buckets, memory_order_acquire);
+  rht_entry* e = atomic_load_explicit(&b->heads[h & (b->capacity - 1)],
+                                      memory_order_acquire);
+  while (e) {
+    if (e->hash == h && rht->key_eq(e->key, key)) {
+      value = e->value;
+      break;
+    }
+    e = atomic_load_explicit(&e->next, memory_order_acquire);
+  }
+  epoch_exit();
+  return value;
+}
+
+int rht_remove(rht_table* rht, const void* key) {
+  size_t h = ht_mix(rht->hash(key));
+  pthread_mutex_lock(&rht->write_lock);
+  rht_buckets* b = atomic_load_explicit(&rht->buckets, memory_order_relaxed);
+  _Atomic(rht_entry*)* link = rht_find_link(rht, b, key, h);
+  rht_entry* e = atomic_load_explicit(link, memory_order_relaxed);
+  if (!e) {
+    pthread_mutex_unlock(&rht->write_lock);
+    return -1;
+  }
+  /* Readers already on e can still follow its next pointer */
+  atomic_store_explicit(
+      link, atomic_load_explicit(&e->next, memory_order_relaxed),
+      memory_order_release);
+  size_t size = atomic_load_explicit(&rht->size, memory_order_relaxed);
+  atomic_store_explicit(&rht->size, size - 1, memory_order_relaxed);
+  pthread_mutex_unlock(&rht->write_lock);
+  rht_retire(rht, e, rht_reclaim_entry);
+  return 0;
+}
+
+void rht_foreach(const rht_table* rht,
+                 ht_iter_func func,
+                 const size_t limit,
+                 void* user_data) {
+  if (!rht || !func)
+    return;
+  size_t count = 0;
+  epoch_enter();
+  rht_buckets* b = atomic_load_explicit(&rht->buckets, memory_order_acquire);
+  for (size_t i = 0; i < b->capacity; i++) {
+    rht_entry* e = atomic_load_explicit(&b->heads[i], memory_order_acquire);
+    while (e) {
+      func(e->key, e->value, user_data);
+      count++;
+      if (limit != 0 && count >= limit) {
+        epoch_exit();
+        return;
+      }
+      e = atomic_load_explicit(&e->next, memory_order_acquire);
+    }
+  }
+  epoch_exit();
+}
+
+/* Called with the write lock held. Readers may still be walking the old
+   array, so entries are copied into the new one instead of relinked, and
+   the old array with its entries is retired as a whole. */
+static int rht_resize(rht_table* rht, const size_t new_capacity) {
+  rht_buckets* old = atomic_load_explicit(&rht->buckets, memory_order_relaxed);
+  rht_buckets* b = rht_buckets_new(new_capacity);
+  if (!b)
+    return -1;
+  for (size_t i = 0; i < old->capacity; i++) {
+    rht_entry* e = atomic_load_explicit(&old->heads[i], memory_order_relaxed);
+    while (e) {
+      rht_entry* copy = malloc(sizeof(rht_entry));
+      if (!copy) {
+        rht_free_buckets(b);
+        return -1;
+      }
+      size_t idx = e->hash & (new_capacity - 1);
+      copy->key = e->key;
+      copy->value = e->value;
+      copy->hash = e->hash;
+      atomic_init(&copy->next, atomic_load_explicit(&b->heads[idx],
+                                                    memory_order_relaxed));
+      atomic_store_explicit(&b->heads[idx], copy, memory_order_relaxed);
+      e = atomic_load_explicit(&e->next, memory_order_relaxed);
+    }
+  }
+  atomic_store_explicit(&rht->buckets, b, memory_order_release);
+  epoch_retire(&old->retire, rht_reclaim_buckets, NULL);
+  return 0;
+}
+
+size_t rht_size(const rht_table* rht) {
+  return rht ? atomic_load_explicit(&rht->size, memory_order_relaxed) : 0;
+}
+
+void rht_read_lock(void) {
+  epoch_enter();
+}
+
+void rht_read_unlock(void) {
+  epoch_exit();
+}
@@ -0,0 +1,71 @@
+#ifndef HASHTABLE_RCU_H
+#define HASHTABLE_RCU_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "epoch.h"
+#include "hashtable.h"
+
+/* Entry; key, value and hash never change once published */
+typedef struct rht_entry {
+  void* key;
+  void* value;
+  size_t hash;
+  _Atomic(struct rht_entry*) next;
+  epoch_node retire;
+} rht_entry;
+
+/* Bucket array, replaced as a whole on resize */
+typedef struct rht_buckets {
+  size_t capacity; /* power of two */
+  epoch_node retire;
+  _Atomic(rht_entry*) heads[];
+} rht_buckets;
+
+/* Read-mostly hash table. Readers take no locks: they walk the buckets
+   with acquire loads inside an epoch read-side section. Writers are
+   serialized by a mutex, publish with release stores and hand unlinked
+   entries and old bucket arrays to epoch based reclamation. */
+typedef struct rht_table {
+  _Atomic(rht_buckets*) buckets;
+  atomic_size_t size;
+  atomic_size_t refs; /* the owner, plus retired entries not yet freed */
+  pthread_mutex_t write_lock;
+  hash_func hash;
+  key_eq_func key_eq;
+  ht_free_func free_key;
+  ht_free_func free_value;
+} rht_table;
+
+/* API
+   rht_get may run on any number of threads alongside one another and
+   alongside writers. The value it returns may be reclaimed once the key is
+   replaced or removed; callers that keep using it bracket the lookup with
+   rht_read_lock/rht_read_unlock. Writes may be made inside a read-side
+   section too, e.g. from an rht_foreach callback; none of the calls waits
+   for readers. free_key and free_value may run during any later write, on
+   any table, and must not call back into a read-mostly table. An insert
+   that grows the table copies every entry into the new bucket array with
+   the write lock held: readers go on, other writers wait. rht_destroy
+   requires all other threads to be done with the table; values retired
+   before it are freed once their readers are gone. */
+rht_table* rht_create(const size_t capacity,
+                      hash_func hash,
+                      key_eq_func key_eq,
+                      ht_free_func free_key,
+                      ht_free_func free_value);
+void rht_destroy(rht_table* rht);
+int rht_insert(rht_table* rht, void* key, void* value);
+void* rht_get(const rht_table* rht, const void* key);
+int rht_remove(rht_table* rht, const void* key);
+void rht_foreach(const rht_table* rht,
+                 ht_iter_func func,
+                 const size_t limit,
+                 void* user_data);
+size_t rht_size(const rht_table* rht);
+void rht_read_lock(void);
+void rht_read_unlock(void);
+
+#endif
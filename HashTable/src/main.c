@@ -4,7 +4,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "dict.h"
 #include "hashtable.h"
+#include "hashtable_oa.h"
 
 typedef struct {
   int id;
@@ -12,17 +14,9 @@ typedef struct {
   double balance;
 } User;
 
-typedef struct {
-  char* trad;
-  char* simp;
-  char* pinyin;
-  char* translation;
-} ChineseDictEntry;
-
 char* xstrdup(const char* s);
 char* xstrcpy(char* dest, const char* src, const size_t destsize);
 void free_user(void* ptr);
-void free_chin(void* ptr);
 size_t str_hash(const void* key);
 size_t int_hash(const void* key);
 int str_eq(const void* a, const void* b);
@@ -34,6 +28,8 @@ uint64_t* create_key(const int value);
 void example1(void);
 void example2(void);
 void example3(void);
+void example4(void);
+void example5(void);
 int main(void);
 
 char* xstrdup(const char* s) {
@@ -60,15 +56,6 @@ void free_user(void* ptr) {
   free(u);
 }
 
-void free_chin(void* ptr) {
-  ChineseDictEntry* d = ptr;
-  free(d->trad);
-  free(d->simp);
-  free(d->pinyin);
-  free(d->translation);
-  free(d);
-}
-
 size_t str_hash(const void* key) {
   const char* s = key;
   size_t h = 5381;
@@ -89,6 +76,9 @@ size_t int_hash(const void* key) {
 }
 
 int str_eq(const void* a, const void* b) {
+  /* Interned keys are equal exactly when their pointers are */
+  if (a == b)
+    return 1;
   return strcmp((const char*)a, (const char*)b) == 0;
 }
 
@@ -303,55 +293,26 @@ void example3(void) {
 void example4(void) {
   printf("\nExample 4 (string keys, struct data)\n");
 
-  hash_table* chin = ht_create(0, str_hash, str_eq, free, free_chin);
+  hash_table* chin = ht_create(0, str_hash, str_eq, NULL, NULL);
   if (!chin) {
     fprintf(stderr, "Failed to create hash table\n");
     abort();
   }
 
-  FILE* fp = fopen("data/handedict.txt", "r");
-  char* line = NULL;
-  size_t len = 0;
-
-  if (fp == NULL) {
-    perror("Failed to open file");
+  /* Keys and entries point into the loaded file, parsed on all CPUs */
+  dict_file* dict = dict_load_parallel("data/handedict.txt", 0);
+  if (!dict) {
+    perror("Failed to load file");
     abort();
   }
-
-  while (getline(&line, &len, fp) != -1) {
-    line[strcspn(line, "\n")] = '\0';
-
-    char* field = line;
-    char* tab;
-    ChineseDictEntry* d = malloc(sizeof(ChineseDictEntry));
-
-    d->trad = NULL;
-    d->simp = NULL;
-    d->pinyin = NULL;
-    d->translation = NULL;
-    int index = 0;
-
-    while ((tab = strchr(field, '\t'))) {
-      *tab = '\0';
-      index++;
-      switch (index) {
-        case 1:
-          d->trad = xstrdup(field);
-          break;
-        case 2:
-          d->simp = xstrdup(field);
-          break;
-        case 3:
-          d->pinyin = xstrdup(field);
-          break;
-      }
-      field = tab + 1;
-    }
-    d->translation = xstrdup(field);
-    ht_insert(chin, xstrdup(d->trad), d);
+  /* Repeated keys, and simplified forms equal to them, share one pointer */
+  intern_pool* pool = intern_create(dict->count);
+  if (!pool || dict_intern(dict, pool) != 0) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
   }
-  free(line);
-  fclose(fp);
+  for (size_t i = 0; i < dict->count; i++)
+    ht_insert(chin, dict->entries[i].trad, &dict->entries[i]);
 
   const char* key1 = "我";
   ChineseDictEntry* found = ht_get(chin, key1);
@@ -407,7 +368,53 @@ void example4(void) {
   printf("-------\nSize: %ld\n", ht_size(chin));
   puts("-------");
 
+#ifdef CONTAINER_STATS
+  ht_statistics st = ht_stats(chin);
+  printf("Lookups: %zu, resizes: %zu, rehashed: %zu\nChain lengths:", st.lookups,
+         st.resizes, st.rehashed);
+  for (int i = 0; i < HT_STATS_CHAIN; i++)
+    printf(" %zu", st.chain[i]);
+  puts("\n-------");
+#endif
+
   ht_destroy(chin);
+  intern_destroy(pool);
+  dict_free(dict);
+}
+
+void example5(void) {
+  printf("\nExample 5 (open addressing, integer keys, string data)\n");
+
+  oa_table* oa = oa_create(0, int_hash, int_eq, free, free);
+  if (!oa) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+
+  char buf[32];
+  for (int i = 0; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "value-%d", i);
+    oa_insert(oa, create_key(i), xstrdup(buf));
+  }
+  for (int i = 0; i < 5000; i += 2) {
+    uint64_t k = i;
+    oa_remove(oa, &k);
+  }
+
+  oa_insert(oa, create_key(4999), xstrdup("Alfred"));
+  printf("4999 data replaced\n");
+
+  uint64_t lookup = 42;
+  printf("42=%s\n", (char*)oa_get(oa, &lookup));
+  lookup = 43;
+  printf("43=%s\n", (char*)oa_get(oa, &lookup));
+  lookup = 4999;
+  printf("4999=%s\n", (char*)oa_get(oa, &lookup));
+
+  printf("-------\nSize: %ld\n", oa_size(oa));
+  puts("-------");
+
+  oa_destroy(oa);
 }
 
 int main(void) {
@@ -415,5 +422,6 @@ int main(void) {
   example2();
   example3();
   example4();
+  example5();
   return 0;
 }
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hashtable.h"
+#include "suite.h"
+
+const char* const suite_container = "hash_table";
+const char* const suite_dict_path = "data/handedict.txt";
+
+/* djb2, the same hash the demo uses */
+static size_t str_hash(const void* key) {
+  const char* s = key;
+  size_t h = 5381;
+  while (*s)
+    h = ((h << 5) + h) + (unsigned char)*s++;
+  return h;
+}
+
+static int str_eq(const void* a, const void* b) {
+  return suite_str_cmp(a, b) == 0;
+}
+
+static hash_table* create(void) {
+  hash_table* ht = ht_create(0, str_hash, str_eq, NULL, NULL);
+  if (!ht) {
+    fprintf(stderr, "Failed to create hash table\n");
+    abort();
+  }
+  return ht;
+}
+
+static void count_entry(const void* key, const void* value, void* user_data) {
+  (void)key;   /* unused */
+  (void)value; /* unused */
+  (*(size_t*)user_data)++;
+}
+
+static void run_insert(const suite_keys* k, char** keys, const char* name) {
+  if (!suite_enabled(name))
+    return;
+  hash_table* ht = create();
+  suite_begin();
+  for (size_t i = 0; i < k->n; i++)
+    ht_insert(ht, keys[i], keys[i]);
+  suite_end(k, name, k->n);
+  ht_destroy(ht);
+}
+
+/* Example 4: every line inserted in file order, repeated keys replacing
+   the earlier entry */
+void* suite_fill_dict(ChineseDictEntry* entries, const size_t n) {
+  hash_table* ht = create();
+  for (size_t i = 0; i < n; i++)
+    ht_insert(ht, entries[i].trad, &entries[i]);
+  return ht;
+}
+
+void suite_free_dict(void* container) {
+  ht_destroy(container);
+}
+
+/* Lookups go through the keys backwards, so not in insertion order */
+void suite_run(const suite_keys* k) {
+  size_t n = k->n;
+  run_insert(k, k->random, "insert_random");
+  run_insert(k, k->sorted, "insert_sequential");
+
+  hash_table* ht = create();
+  for (size_t i = 0; i < n; i++)
+    ht_insert(ht, k->random[i], k->random[i]);
+
+  if (suite_enabled("get_hit")) {
+    size_t found = 0;
+    suite_begin();
+    for (size_t i = n; i-- > 0;)
+      found += ht_get(ht, k->random[i]) != NULL;
+    suite_end(k, "get_hit", n);
+    if (found != n)
+      fprintf(stderr, "get_hit: %zu of %zu found\n", found, n);
+  }
+
+  if (suite_enabled("get_miss")) {
+    size_t found = 0;
+    suite_begin();
+    for (size_t i = n; i-- > 0;)
+      found += ht_get(ht, k->misses[i]) != NULL;
+    suite_end(k, "get_miss", n);
+    if (found != 0)
+      fprintf(stderr, "get_miss: %zu found\n", found);
+  }
+
+  if (suite_enabled("iterate")) {
+    size_t count = 0;
+    suite_begin();
+    ht_foreach(ht, count_entry, 0, &count);
+    suite_end(k, "iterate", count);
+  }
+
+  /* No sort workload, hash tables keep no order */
+
+  if (suite_enabled("remove")) {
+    suite_begin();
+    for (size_t i = n; i-- > 0;)
+      ht_remove(ht, k->random[i]);
+    suite_end(k, "remove", n);
+    if (ht_size(ht) != 0)
+      fprintf(stderr, "remove: %zu entries left\n", ht_size(ht));
+  }
+
+  ht_destroy(ht);
+}
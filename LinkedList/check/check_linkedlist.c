@@ -0,0 +1,513 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "linkedlist.h"
+#include "linkedlist_unrolled.h"
+
+/* Randomized checks of the list against a reference array. Every pass
+   runs random operations on a small key range, so that keys are inserted,
+   replaced and removed many times, and checks the structure as it goes. */
+
+#define CHECK_KEYS 512
+#define CHECK_DEFAULT_OPS 200000
+/* Operations between two full structure checks */
+#define CHECK_EVERY 97
+
+int main(int argc, char** argv);
+
+/* Reference: ref[k] is the tag stored under key k, 0 if absent */
+typedef struct check_ref {
+  uintptr_t tag[CHECK_KEYS];
+  size_t size;
+} check_ref;
+
+static int key_vals[CHECK_KEYS];
+static uint64_t rng_state;
+static long live_data; /* data objects not freed yet */
+static uintptr_t next_tag;
+
+/* ---------- Helpers ---------- */
+
+static uint64_t rng_next(void) {
+  uint64_t x = (rng_state += 0x9e3779b97f4a7c15ULL);
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static size_t rng_below(const size_t n) {
+  return (size_t)(rng_next() % n);
+}
+
+static void fail(const char* pass, const char* what, const size_t op) {
+  fprintf(stderr, "%s: %s (after %zu ops)\n", pass, what, op);
+  abort();
+}
+
+static int int_cmp(const void* a, const void* b) {
+  int ia = *(const int*)a;
+  int ib = *(const int*)b;
+  return (ia > ib) - (ia < ib);
+}
+
+/* Data is a heap tag, so the list's ownership of data can be checked */
+static uintptr_t* make_data(void) {
+  uintptr_t* d = malloc(sizeof(uintptr_t));
+  if (!d) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  *d = ++next_tag;
+  live_data++;
+  return d;
+}
+
+static void free_data(void* ptr) {
+  live_data--;
+  free(ptr);
+}
+
+static void ref_init(check_ref* ref) {
+  memset(ref, 0, sizeof(*ref));
+}
+
+static void ref_set(check_ref* ref, const int k, const uintptr_t tag) {
+  ref->size += ref->tag[k] == 0;
+  ref->tag[k] = tag;
+}
+
+static void ref_clear(check_ref* ref, const int k) {
+  ref->size -= ref->tag[k] != 0;
+  ref->tag[k] = 0;
+}
+
+/* First key not less than k, or -1 */
+static int ref_ceil(const check_ref* ref, int k) {
+  for (; k < CHECK_KEYS; k++)
+    if (ref->tag[k] != 0)
+      return k;
+  return -1;
+}
+
+/* A key near k (and inside the key range), for runs of close keys */
+static int near_key(const int k) {
+  int d = (int)rng_below(9) - 4;
+  int n = k + d;
+  return n < 0 ? 0 : n >= CHECK_KEYS ? CHECK_KEYS - 1 : n;
+}
+
+/* Allocator without bulk release, so every node goes through free; it
+   checks the size asked for matches the node's tower */
+static long live_nodes;
+
+static void* check_alloc(void* ctx, size_t size) {
+  (void)ctx; /* unused */
+  size_t* p = malloc(size + sizeof(max_align_t));
+  if (!p)
+    return NULL;
+  *p = size;
+  live_nodes++;
+  return (char*)p + sizeof(max_align_t);
+}
+
+static void check_free(void* ctx, void* ptr) {
+  (void)ctx; /* unused */
+  size_t* p = (size_t*)((char*)ptr - sizeof(max_align_t));
+  if (*p != LL_NODE_SIZE(((ll_node*)ptr)->level)) {
+    fprintf(stderr, "node freed with a tower of the wrong size\n");
+    abort();
+  }
+  live_nodes--;
+  free(p);
+}
+
+/* ---------- Structure ---------- */
+
+/* Node chain, express levels and contents against the reference */
+static void check_list(const linked_list* list,
+                       const check_ref* ref,
+                       const char* pass,
+                       const size_t op) {
+  size_t count = 0;
+  size_t promoted[LL_MAX_LEVEL] = {0};
+  int finger_found = list->finger == NULL;
+  ll_node* prev = NULL;
+  for (ll_node* n = list->head; n; prev = n, n = n->next) {
+    int k = *(int*)n->key;
+    finger_found |= n == list->finger;
+    if (n->prev != prev)
+      fail(pass, "broken prev link", op);
+    if (prev && *(int*)prev->key >= k)
+      fail(pass, "node chain not strictly ascending", op);
+    if (ref->tag[k] == 0 || *(uintptr_t*)n->data != ref->tag[k])
+      fail(pass, "node holds a key or data the reference lacks", op);
+    if (n->level < 0 || n->level > list->level)
+      fail(pass, "tower higher than the list", op);
+    for (int l = 0; l < n->level; l++)
+      promoted[l]++;
+    count++;
+  }
+  if (list->tail != prev)
+    fail(pass, "tail is not the last node", op);
+  if (count != list->size || count != ref->size)
+    fail(pass, "size differs from the reference", op);
+  if (!finger_found)
+    fail(pass, "finger is not a node of the list", op);
+
+  /* Level l links, in order, exactly the nodes with a tower above l */
+  for (int l = 0; l < LL_MAX_LEVEL; l++) {
+    if (l >= list->level) {
+      if (list->skip_head[l])
+        fail(pass, "express level above the top in use", op);
+      continue;
+    }
+    size_t linked = 0;
+    const ll_node* last = NULL;
+    for (ll_node* n = list->skip_head[l]; n; n = n->skip[l]) {
+      if (n->level <= l)
+        fail(pass, "node linked above its tower", op);
+      if (last && int_cmp(last->key, n->key) >= 0)
+        fail(pass, "express level not ascending", op);
+      last = n;
+      linked++;
+    }
+    if (linked != promoted[l])
+      fail(pass, "express level misses promoted nodes", op);
+    if (linked == 0 && l == list->level - 1)
+      fail(pass, "empty top express level", op);
+  }
+
+  for (int k = 0; k < CHECK_KEYS; k++) {
+    uintptr_t* d = ll_get(list, &key_vals[k]);
+    if ((d ? *d : 0) != ref->tag[k])
+      fail(pass, "ll_get differs from the reference", op);
+  }
+}
+
+/* ---------- Passes ---------- */
+
+/* ll_insert, ll_remove and ll_get in random order: towers are linked and
+   unlinked on every level, and the top level grows and shrinks */
+static void pass_skip(const size_t ops, const ll_allocator* alloc) {
+  const char* pass = alloc ? "skip list (malloc nodes)" : "skip list";
+  linked_list* list =
+      ll_create_with_allocator(int_cmp, NULL, free_data, alloc);
+  check_ref ref;
+  if (!list) {
+    fprintf(stderr, "Failed to create list\n");
+    abort();
+  }
+  ref_init(&ref);
+  for (size_t op = 0; op < ops; op++) {
+    /* Phases of growth and shrinking, so the list empties now and then */
+    int grow = (op / 5000) % 2 == 0;
+    int k = (int)rng_below(CHECK_KEYS);
+    if (rng_below(100) < (grow ? 70u : 30u)) {
+      uintptr_t* d = make_data();
+      if (ll_insert(list, &key_vals[k], d) != 0)
+        fail(pass, "ll_insert failed", op);
+      ref_set(&ref, k, *d);
+    } else {
+      int r = ll_remove(list, &key_vals[k]);
+      if ((r == 0) != (ref.tag[k] != 0))
+        fail(pass, "ll_remove result differs from the reference", op);
+      ref_clear(&ref, k);
+    }
+    if (op % CHECK_EVERY == 0)
+      check_list(list, &ref, pass, op);
+  }
+  check_list(list, &ref, pass, ops);
+  ll_destroy(list);
+  if (live_data != 0)
+    fail(pass, "data leaked or freed twice", ops);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* Cursor inserts of runs of close keys, seeks and steps, mixed with plain
+   inserts (which move the finger) and removals. The cursor must stay
+   usable as long as its own node is not removed. */
+static void pass_cursor(const size_t ops) {
+  const char* pass = "finger and cursor";
+  linked_list* list = ll_create(int_cmp, NULL, free_data);
+  check_ref ref;
+  ll_cursor cur;
+  if (!list) {
+    fprintf(stderr, "Failed to create list\n");
+    abort();
+  }
+  ref_init(&ref);
+  ll_cursor_init(&cur, list);
+  int last = 0; /* last key inserted with ll_insert */
+  for (size_t op = 0; op < ops; op++) {
+    int grow = (op / 5000) % 2 == 0;
+    size_t what = rng_below(100);
+    if (what < 30) {
+      /* Cursor insert next to the cursor's key */
+      int k = cur.node ? near_key(*(int*)cur.node->key)
+                       : (int)rng_below(CHECK_KEYS);
+      uintptr_t* d = make_data();
+      if (ll_cursor_insert(&cur, &key_vals[k], d) != 0)
+        fail(pass, "ll_cursor_insert failed", op);
+      if (!cur.node || *(int*)cur.node->key != k)
+        fail(pass, "cursor not on the inserted node", op);
+      ref_set(&ref, k, *d);
+    } else if (what < 45) {
+      /* Clustered plain inserts, found from the finger */
+      int k = rng_below(4) ? near_key(last) : (int)rng_below(CHECK_KEYS);
+      uintptr_t* d = make_data();
+      if (ll_insert(list, &key_vals[k], d) != 0)
+        fail(pass, "ll_insert failed", op);
+      if (!list->finger || *(int*)list->finger->key != k)
+        fail(pass, "finger not on the inserted node", op);
+      ref_set(&ref, k, *d);
+      last = k;
+    } else if (what < (grow ? 60u : 75u)) {
+      int k = rng_below(2) && cur.node ? near_key(*(int*)cur.node->key)
+                                       : (int)rng_below(CHECK_KEYS);
+      int own = cur.node && *(int*)cur.node->key == k;
+      int r = ll_remove(list, &key_vals[k]);
+      if ((r == 0) != (ref.tag[k] != 0))
+        fail(pass, "ll_remove result differs from the reference", op);
+      ref_clear(&ref, k);
+      /* Removing the cursor's own node ends the cursor */
+      if (own)
+        ll_cursor_init(&cur, list);
+    } else if (what < 85) {
+      int k = rng_below(2) && cur.node ? near_key(*(int*)cur.node->key)
+                                       : (int)rng_below(CHECK_KEYS);
+      int want = ref_ceil(&ref, k);
+      int r = ll_cursor_seek(&cur, &key_vals[k]);
+      if ((r == 0) != (want >= 0) || (r == 0) != (cur.node != NULL))
+        fail(pass, "ll_cursor_seek result differs from the reference", op);
+      if (cur.node && *(int*)cur.node->key != want)
+        fail(pass, "ll_cursor_seek on the wrong node", op);
+    } else {
+      for (size_t steps = rng_below(8); steps > 0 && cur.node; steps--) {
+        int want = ref_ceil(&ref, *(int*)cur.node->key + 1);
+        int r = ll_cursor_next(&cur);
+        if ((r == 0) != (want >= 0) ||
+            (cur.node && *(int*)cur.node->key != want))
+          fail(pass, "ll_cursor_next skipped or repeated a key", op);
+      }
+    }
+    if (op % CHECK_EVERY == 0)
+      check_list(list, &ref, pass, op);
+  }
+  check_list(list, &ref, pass, ops);
+  ll_destroy(list);
+  if (live_data != 0)
+    fail(pass, "data leaked or freed twice", ops);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* ll_bulk_insert of batches that are sorted, reversed, nearly sorted or
+   random with repeated keys, into a list that also changes through single
+   inserts and removals. Pairs apply in order, so the last of equal keys
+   wins and the others' data is freed. */
+static void pass_bulk(const size_t ops) {
+  const char* pass = "bulk insert";
+  linked_list* list = ll_create(int_cmp, NULL, free_data);
+  ll_pair* pairs = malloc(CHECK_KEYS * 2 * sizeof(ll_pair));
+  check_ref ref;
+  if (!list || !pairs) {
+    fprintf(stderr, "Failed to create list\n");
+    abort();
+  }
+  ref_init(&ref);
+  if (ll_bulk_insert(list, NULL, 0) != 0)
+    fail(pass, "empty ll_bulk_insert failed", 0);
+  for (size_t op = 0; op < ops;) {
+    size_t n = rng_below(8) == 0 ? rng_below(CHECK_KEYS * 2) : rng_below(24);
+    size_t mode = rng_below(4);
+    int base = (int)rng_below(CHECK_KEYS);
+    /* Ascending, descending, nearly sorted or random; runs wrap around
+       the key range */
+    for (size_t i = 0; i < n; i++) {
+      int k;
+      if (mode == 0)
+        k = (base + (int)i) % CHECK_KEYS;
+      else if (mode == 1)
+        k = (base + CHECK_KEYS - (int)(i % CHECK_KEYS)) % CHECK_KEYS;
+      else if (mode == 2)
+        k = near_key((base + (int)i) % CHECK_KEYS);
+      else
+        k = (int)rng_below(CHECK_KEYS);
+      pairs[i].key = &key_vals[k];
+      pairs[i].data = make_data();
+    }
+    /* Later pairs replace earlier ones, as with ll_insert in order */
+    for (size_t i = 0; i < n; i++)
+      ref_set(&ref, *(int*)pairs[i].key, *(uintptr_t*)pairs[i].data);
+    if (ll_bulk_insert(list, pairs, n) != 0)
+      fail(pass, "ll_bulk_insert failed", op);
+    if (n > 0 && list->finger != list->tail)
+      fail(pass, "finger not on the tail after a bulk insert", op);
+    op += n ? n : 1;
+
+    /* Single removals and inserts between the batches */
+    for (size_t i = rng_below(n + 8); i > 0; i--, op++) {
+      int k = (int)rng_below(CHECK_KEYS);
+      if (rng_below(3) == 0) {
+        uintptr_t* d = make_data();
+        if (ll_insert(list, &key_vals[k], d) != 0)
+          fail(pass, "ll_insert failed", op);
+        ref_set(&ref, k, *d);
+      } else {
+        int r = ll_remove(list, &key_vals[k]);
+        if ((r == 0) != (ref.tag[k] != 0))
+          fail(pass, "ll_remove result differs from the reference", op);
+        ref_clear(&ref, k);
+      }
+    }
+    check_list(list, &ref, pass, op);
+  }
+  ll_destroy(list);
+  free(pairs);
+  if (live_data != 0)
+    fail(pass, "data leaked or freed twice", ops);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* Keys seen by ul_foreach / ul_foreach_reverse, in visiting order */
+typedef struct check_walk {
+  int keys[CHECK_KEYS];
+  uintptr_t tags[CHECK_KEYS];
+  size_t n;
+} check_walk;
+
+static void walk_item(void* key, void* data, void* user_data) {
+  check_walk* w = user_data;
+  if (w->n < CHECK_KEYS) {
+    w->keys[w->n] = *(int*)key;
+    w->tags[w->n] = *(uintptr_t*)data;
+  }
+  w->n++;
+}
+
+/* Node fill, order across nodes, both iteration directions (also with a
+   limit) and ul_get against the reference */
+static void check_unrolled(const unrolled_list* list,
+                           const check_ref* ref,
+                           const char* pass,
+                           const size_t op) {
+  size_t count = 0;
+  const ul_node* prev = NULL;
+  const void* last = NULL;
+  for (const ul_node* n = list->head; n; prev = n, n = n->next) {
+    if (n->prev != prev)
+      fail(pass, "broken prev link", op);
+    if (n->count == 0 || n->count > UL_NODE_CAPACITY)
+      fail(pass, "node empty or over capacity", op);
+    for (size_t i = 0; i < n->count; i++) {
+      if (last && int_cmp(last, n->keys[i]) >= 0)
+        fail(pass, "keys not strictly ascending", op);
+      last = n->keys[i];
+    }
+    count += n->count;
+  }
+  if (list->tail != prev)
+    fail(pass, "tail is not the last node", op);
+  if (count != list->size || count != ul_size(list) || count != ref->size)
+    fail(pass, "size differs from the reference", op);
+
+  check_walk walk = {.n = 0};
+  ul_foreach(list, walk_item, 0, &walk);
+  size_t i = 0;
+  for (int k = 0; k < CHECK_KEYS; k++) {
+    if (ref->tag[k] == 0)
+      continue;
+    if (i >= walk.n || walk.keys[i] != k || walk.tags[i] != ref->tag[k])
+      fail(pass, "ul_foreach differs from the reference", op);
+    i++;
+  }
+  if (walk.n != ref->size)
+    fail(pass, "ul_foreach visited extra pairs", op);
+
+  walk.n = 0;
+  ul_foreach_reverse(list, walk_item, 0, &walk);
+  if (walk.n != ref->size)
+    fail(pass, "ul_foreach_reverse visited extra pairs", op);
+  i = walk.n;
+  for (int k = 0; k < CHECK_KEYS; k++) {
+    if (ref->tag[k] == 0)
+      continue;
+    if (i == 0 || walk.keys[i - 1] != k)
+      fail(pass, "ul_foreach_reverse differs from the reference", op);
+    i--;
+  }
+
+  size_t limit = rng_below(8) + 1;
+  walk.n = 0;
+  ul_foreach(list, walk_item, limit, &walk);
+  if (walk.n != (ref->size < limit ? ref->size : limit))
+    fail(pass, "ul_foreach ignores its limit", op);
+
+  for (int k = 0; k < CHECK_KEYS; k++) {
+    uintptr_t* d = ul_get(list, &key_vals[k]);
+    if ((d ? *d : 0) != ref->tag[k])
+      fail(pass, "ul_get differs from the reference", op);
+  }
+}
+
+/* ul_insert and ul_remove at random, in runs of close keys and as
+   appends past the tail, so nodes split, merge and borrow pairs */
+static void pass_unrolled(const size_t ops) {
+  const char* pass = "unrolled list";
+  unrolled_list* list = ul_create(int_cmp, NULL, free_data);
+  check_ref ref;
+  if (!list) {
+    fprintf(stderr, "Failed to create list\n");
+    abort();
+  }
+  ref_init(&ref);
+  int last = 0;
+  for (size_t op = 0; op < ops; op++) {
+    int grow = (op / 5000) % 2 == 0;
+    size_t how = rng_below(3);
+    int k = how == 0   ? (int)rng_below(CHECK_KEYS)
+            : how == 1 ? near_key(last)
+                       : (last + 1) % CHECK_KEYS;
+    if (rng_below(100) < (grow ? 70u : 30u)) {
+      uintptr_t* d = make_data();
+      if (ul_insert(list, &key_vals[k], d) != 0)
+        fail(pass, "ul_insert failed", op);
+      ref_set(&ref, k, *d);
+    } else {
+      int r = ul_remove(list, &key_vals[k]);
+      if ((r == 0) != (ref.tag[k] != 0))
+        fail(pass, "ul_remove result differs from the reference", op);
+      ref_clear(&ref, k);
+    }
+    last = k;
+    if (op % CHECK_EVERY == 0)
+      check_unrolled(list, &ref, pass, op);
+  }
+  check_unrolled(list, &ref, pass, ops);
+  ul_destroy(list);
+  if (live_data != 0)
+    fail(pass, "data leaked or freed twice", ops);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+int main(int argc, char** argv) {
+  size_t ops = argc > 1 ? strtoul(argv[1], NULL, 10) : CHECK_DEFAULT_OPS;
+  if (ops == 0)
+    ops = CHECK_DEFAULT_OPS;
+  rng_state = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+  for (int k = 0; k < CHECK_KEYS; k++)
+    key_vals[k] = k;
+
+  ll_allocator counted = {check_alloc, check_free, NULL, NULL};
+  pass_skip(ops, NULL);
+  pass_skip(ops, &counted);
+  pass_cursor(ops);
+  pass_bulk(ops);
+  pass_unrolled(ops);
+  if (live_nodes != 0) {
+    fprintf(stderr, "%ld nodes not freed\n", live_nodes);
+    abort();
+  }
+  return 0;
+}
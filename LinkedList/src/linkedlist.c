@@ -1,207 +1,426 @@
 #include "linkedlist.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#include "slab.h"
+
+/* Calls the comparison function, counting the call when built with
+   CONTAINER_STATS (also through a const list) */
+static inline int ll_cmp(const linked_list* list,
+                         const void* a,
+                         const void* b) {
+#ifdef CONTAINER_STATS
+  ((linked_list*)list)->stats.cmps++;
+#endif
+  return list->cmp(a, b);
+}
+
+/* Default allocator: one slab pool per tower height owned by the list, so
+   a node and its tower are a single fixed size object. Pools for the rarer
+   tall towers are created on first use, with fewer objects per slab. */
+typedef struct ll_slab_set {
+  slab_pool* pools[LL_MAX_LEVEL + 1];
+} ll_slab_set;
+
+static void* ll_slab_alloc(void* ctx, size_t size) {
+  ll_slab_set* set = ctx;
+  size_t level = (size - sizeof(ll_node)) / sizeof(ll_node*);
+  if (!set->pools[level]) {
+    size_t objs = SLAB_DEFAULT_OBJECTS >> (2 * level);
+    set->pools[level] = slab_create(size, objs < 4 ? 4 : objs);
+    if (!set->pools[level])
+      return NULL;
+  }
+  return slab_alloc(set->pools[level]);
+}
+
+/* The pool is picked by the tower height kept in the node */
+static void ll_slab_free(void* ctx, void* ptr) {
+  ll_slab_set* set = ctx;
+  slab_free(set->pools[((ll_node*)ptr)->level], ptr);
+}
+
+static void ll_slab_release(void* ctx) {
+  ll_slab_set* set = ctx;
+  for (int l = 0; l <= LL_MAX_LEVEL; l++)
+    if (set->pools[l])
+      slab_destroy(set->pools[l]);
+  free(set);
+}
+
+/* Draws the express level of a new node: each level with probability 1/4,
+   at most one above the current top */
+static int ll_random_level(linked_list* list) {
+  uint64_t x = list->rng;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  list->rng = x;
+  int level = 0;
+  while ((x & 3) == 0 && level < LL_MAX_LEVEL && level <= list->level) {
+    level++;
+    x >>= 2;
+  }
+  return level;
+}
+
+static ll_node* ll_node_new(linked_list* list,
+                            void* key,
+                            void* data,
+                            const int level) {
+  ll_node* n = list->alloc.alloc(list->alloc.ctx, LL_NODE_SIZE(level));
+  if (!n)
+    return NULL;
+  n->key = key;
+  n->data = data;
+  n->level = level;
+  return n;
+}
+
+/* Finds the first node not less than key, or NULL. update[i] receives the
+   last node before key on express level i + 1 (NULL for the head), as
+   needed to link or unlink a tower there. */
+static ll_node* ll_find(const linked_list* list,
+                        const void* key,
+                        ll_node** update) {
+  ll_node* x = NULL;
+  for (int l = list->level; l > 0; l--) {
+    ll_node* next = x ? x->skip[l - 1] : list->skip_head[l - 1];
+    while (next && ll_cmp(list, key, next->key) > 0) {
+      x = next;
+      next = x->skip[l - 1];
+    }
+    if (update)
+      update[l - 1] = x;
+  }
+  ll_node* cur = x ? x->next : list->head;
+  while (cur && ll_cmp(list, key, cur->key) > 0)
+    cur = cur->next;
+  return cur;
+}
+
+/* Finds the first node not less than key by walking at most
+   LL_FINGER_STEPS nodes from finger. Stores it (NULL past the tail) in out
+   and returns 0, or returns -1 if key is not close to the finger. */
+static int ll_find_near(const linked_list* list,
+                        ll_node* finger,
+                        const void* key,
+                        ll_node** out) {
+  if (!finger)
+    return -1;
+  int cmp = ll_cmp(list, key, finger->key);
+  ll_node* cur = finger;
+  if (cmp > 0) {
+    for (int i = 0; i < LL_FINGER_STEPS; i++) {
+      cur = cur->next;
+      if (!cur || ll_cmp(list, key, cur->key) <= 0) {
+        *out = cur;
+        return 0;
+      }
+    }
+    return -1;
+  }
+  for (int i = 0; i < LL_FINGER_STEPS; i++) {
+    if (!cur->prev || ll_cmp(list, key, cur->prev->key) > 0) {
+      *out = cur;
+      return 0;
+    }
+    cur = cur->prev;
+  }
+  return -1;
+}
+
+/* Takes the new key and data for an existing node */
+static void ll_replace(linked_list* list, ll_node* n, void* key, void* data) {
+  if (list->free_data)
+    list->free_data(n->data);
+  if (list->free_key)
+    list->free_key(n->key);
+  n->key = key;
+  n->data = data;
+}
 
 linked_list* ll_create(ll_cmp_func cmp,
                        ll_free_func free_key,
                        ll_free_func free_data) {
+  return ll_create_with_allocator(cmp, free_key, free_data, NULL);
+}
+
+linked_list* ll_create_with_allocator(ll_cmp_func cmp,
+                                      ll_free_func free_key,
+                                      ll_free_func free_data,
+                                      const ll_allocator* alloc) {
   if (!cmp)
     return NULL;
   linked_list* list = malloc(sizeof(*list));
   if (!list)
     return NULL;
+  if (alloc) {
+    list->alloc = *alloc;
+  } else {
+    ll_slab_set* set = calloc(1, sizeof(ll_slab_set));
+    if (!set) {
+      free(list);
+      return NULL;
+    }
+    list->alloc =
+        (ll_allocator){ll_slab_alloc, ll_slab_free, ll_slab_release, set};
+  }
   list->head = list->tail = NULL;
   list->size = 0;
   list->cmp = cmp;
   list->free_key = free_key;
   list->free_data = free_data;
+  for (int l = 0; l < LL_MAX_LEVEL; l++)
+    list->skip_head[l] = NULL;
+  list->level = 0;
+  list->rng = 0x9e3779b97f4a7c15ULL;
+  list->finger = NULL;
+#ifdef CONTAINER_STATS
+  memset(&list->stats, 0, sizeof(list->stats));
+#endif
   return list;
 }
 
 void ll_destroy(linked_list* list) {
   if (!list)
     return;
+  /* Node memory is left to the allocator's bulk release if it has one */
   ll_node* cur = list->head;
+  if (!list->free_key && !list->free_data && list->alloc.release)
+    cur = NULL;
   while (cur) {
     ll_node* next = cur->next;
     if (list->free_key)
       list->free_key(cur->key);
     if (list->free_data)
       list->free_data(cur->data);
-    free(cur);
+    if (!list->alloc.release)
+      list->alloc.free(list->alloc.ctx, cur);
     cur = next;
   }
+  if (list->alloc.release)
+    list->alloc.release(list->alloc.ctx);
   free(list);
 }
 
+/* Inserts or replaces key, searching from finger first. Returns the
+   node now holding key, or NULL on allocation failure. */
+static ll_node* ll_insert_near(linked_list* list,
+                               ll_node* finger,
+                               void* key,
+                               void* data) {
+  int level = ll_random_level(list);
+  ll_node* update[LL_MAX_LEVEL];
+  ll_node* cur;
+  /* A node without a tower only needs its place on the node chain */
+  if (level > 0 || ll_find_near(list, finger, key, &cur) != 0)
+    cur = ll_find(list, key, update);
+  if (cur && ll_cmp(list, key, cur->key) == 0) {
+    ll_replace(list, cur, key, data);
+    list->finger = cur;
+    return cur;
+  }
+  ll_node* n = ll_node_new(list, key, data, level);
+  if (!n)
+    return NULL;
+  /* Link on the node chain before cur, or at the tail */
+  n->next = cur;
+  n->prev = cur ? cur->prev : list->tail;
+  if (n->prev)
+    n->prev->next = n;
+  else
+    list->head = n;
+  if (cur)
+    cur->prev = n;
+  else
+    list->tail = n;
+  /* Link the tower; a new top level starts at the head */
+  if (level > list->level) {
+    update[list->level] = NULL;
+    list->level = level;
+  }
+  for (int l = 0; l < level; l++) {
+    ll_node** link = update[l] ? &update[l]->skip[l] : &list->skip_head[l];
+    n->skip[l] = *link;
+    *link = n;
+  }
+  list->size++;
+  list->finger = n;
+  return n;
+}
+
 int ll_insert(linked_list* list, void* key, void* data) {
   if (!list)
     return -1;
-  /* Empty list */
-  if (!list->head) {
-    ll_node* n = malloc(sizeof(*n));
-    if (!n)
-      return -1;
-    n->key = key;
-    n->data = data;
-    n->prev = n->next = NULL;
-    list->head = list->tail = n;
-    list->size = 1;
-    return 0;
-  }
-  int cmp_head = list->cmp(key, list->head->key);
-  int cmp_tail = list->cmp(key, list->tail->key);
-  /* Replace at head */
-  if (cmp_head == 0) {
-    if (list->free_data)
-      list->free_data(list->head->data);
-    if (list->free_key)
-      list->free_key(list->head->key);
-    list->head->key = key;
-    list->head->data = data;
-    return 0;
-  }
-  /* Replace at tail */
-  if (cmp_tail == 0) {
-    if (list->free_data)
-      list->free_data(list->tail->data);
-    if (list->free_key)
-      list->free_key(list->tail->key);
-    list->tail->key = key;
-    list->tail->data = data;
-    return 0;
-  }
-  ll_node* cur;
-  /* Choose direction */
-  if (cmp_tail > 0) {
-    /* Insert after tail (fast path) */
-    ll_node* n = malloc(sizeof(*n));
-    if (!n)
-      return -1;
-    n->key = key;
-    n->data = data;
-    n->prev = list->tail;
-    n->next = NULL;
+  /* Sorted input appends right after the finger */
+  ll_node* finger = list->finger ? list->finger : list->tail;
+#ifdef CONTAINER_STATS
+  size_t cmps = list->stats.cmps;
+  ll_node* n = ll_insert_near(list, finger, key, data);
+  list->stats.inserts++;
+  list->stats.insert_cmps += list->stats.cmps - cmps;
+  return n ? 0 : -1;
+#else
+  return ll_insert_near(list, finger, key, data) ? 0 : -1;
+#endif
+}
+
+/* Stable top-down merge sort of pairs by key; tmp holds n / 2 pairs */
+static void ll_sort_pairs(const linked_list* list,
+                          ll_pair* pairs,
+                          ll_pair* tmp,
+                          const size_t n) {
+  if (n < 2)
+    return;
+  size_t mid = n / 2;
+  ll_sort_pairs(list, pairs, tmp, mid);
+  ll_sort_pairs(list, pairs + mid, tmp, n - mid);
+  if (ll_cmp(list, pairs[mid - 1].key, pairs[mid].key) <= 0)
+    return; /* halves already in order */
+  memcpy(tmp, pairs, mid * sizeof(ll_pair));
+  size_t i = 0, j = mid, k = 0;
+  while (i < mid && j < n)
+    pairs[k++] =
+        ll_cmp(list, pairs[j].key, tmp[i].key) < 0 ? pairs[j++] : tmp[i++];
+  while (i < mid)
+    pairs[k++] = tmp[i++];
+}
+
+/* Appends n to the list being rebuilt by ll_bulk_insert, linking its
+   tower after the last node seen on each express level */
+static void ll_bulk_link(linked_list* list, ll_node** last, ll_node* n) {
+  n->prev = list->tail;
+  if (list->tail)
     list->tail->next = n;
-    list->tail = n;
-    list->size++;
-    return 0;
-  } else if (cmp_head < 0) {
-    /* Insert before head */
-    ll_node* n = malloc(sizeof(*n));
-    if (!n)
-      return -1;
-    n->key = key;
-    n->data = data;
-    n->prev = NULL;
-    n->next = list->head;
-    list->head->prev = n;
+  else
     list->head = n;
-    list->size++;
-    return 0;
-  }
-  /* Middle insertion: walk from the closer end */
-  if (cmp_tail < 0 && -cmp_tail < cmp_head) {
-    /* Walk backward */
-    cur = list->tail->prev;
-    while (cur && list->cmp(key, cur->key) < 0) {
-      cur = cur->prev;
+  list->tail = n;
+  for (int l = 0; l < n->level; l++) {
+    *(last[l] ? &last[l]->skip[l] : &list->skip_head[l]) = n;
+    last[l] = n;
+  }
+  if (n->level > list->level)
+    list->level = n->level;
+}
+
+/* Inserts n pairs with the same result as calling ll_insert on each in
+   order, i.e. later pairs replace earlier ones with an equal key. pairs is
+   sorted in place (stable merge sort, skipped when already sorted) and
+   then merged with the list in a single pass that also rebuilds the
+   express levels. Returns 0, or -1 if memory runs out; the list then
+   holds all pairs before the first one that could not be inserted. */
+int ll_bulk_insert(linked_list* list, ll_pair* pairs, const size_t n) {
+  if (!list || (!pairs && n > 0))
+    return -1;
+  for (size_t i = 1; i < n; i++) {
+    if (ll_cmp(list, pairs[i - 1].key, pairs[i].key) > 0) {
+      ll_pair* tmp = malloc((n / 2) * sizeof(ll_pair));
+      if (!tmp)
+        return -1;
+      ll_sort_pairs(list, pairs, tmp, n);
+      free(tmp);
+      break;
     }
-    if (cur && list->cmp(key, cur->key) == 0) {
+  }
+
+  ll_node* last[LL_MAX_LEVEL] = {NULL};
+  ll_node* old = list->head;
+  int result = 0;
+  list->head = list->tail = NULL;
+  for (size_t i = 0; i < n && result == 0; i++) {
+    /* Of equal pairs only the last one survives */
+    if (i + 1 < n && ll_cmp(list, pairs[i].key, pairs[i + 1].key) == 0) {
       if (list->free_data)
-        list->free_data(cur->data);
+        list->free_data(pairs[i].data);
       if (list->free_key)
-        list->free_key(cur->key);
-      cur->key = key;
-      cur->data = data;
-      return 0;
+        list->free_key(pairs[i].key);
+      continue;
     }
-    /* insert after cur */
-    ll_node* n = malloc(sizeof(*n));
-    if (!n)
-      return -1;
-    n->key = key;
-    n->data = data;
-    n->prev = cur;
-    n->next = cur->next;
-    cur->next->prev = n;
-    cur->next = n;
-  } else {
-    /* Walk forward */
-    cur = list->head->next;
-    while (cur && list->cmp(key, cur->key) > 0) {
-      cur = cur->next;
+    int cmp = -1;
+    while (old && (cmp = ll_cmp(list, pairs[i].key, old->key)) > 0) {
+      ll_node* next = old->next;
+      ll_bulk_link(list, last, old);
+      old = next;
     }
-    if (cur && list->cmp(key, cur->key) == 0) {
-      if (list->free_data)
-        list->free_data(cur->data);
-      if (list->free_key)
-        list->free_key(cur->key);
-      cur->key = key;
-      cur->data = data;
-      return 0;
+    if (old && cmp == 0) {
+      ll_node* next = old->next;
+      ll_replace(list, old, pairs[i].key, pairs[i].data);
+      ll_bulk_link(list, last, old);
+      old = next;
+      continue;
     }
-    /* insert before cur */
-    ll_node* n = malloc(sizeof(*n));
-    if (!n)
-      return -1;
-    n->key = key;
-    n->data = data;
-    n->next = cur;
-    n->prev = cur->prev;
-    cur->prev->next = n;
-    cur->prev = n;
+    ll_node* node = ll_node_new(list, pairs[i].key, pairs[i].data,
+                                ll_random_level(list));
+    if (!node) {
+      result = -1;
+      break;
+    }
+    ll_bulk_link(list, last, node);
+    list->size++;
   }
-  list->size++;
-  return 0;
+  while (old) {
+    ll_node* next = old->next;
+    ll_bulk_link(list, last, old);
+    old = next;
+  }
+  if (list->tail)
+    list->tail->next = NULL;
+  for (int l = 0; l < list->level; l++)
+    *(last[l] ? &last[l]->skip[l] : &list->skip_head[l]) = NULL;
+  list->finger = list->tail;
+  return result;
 }
 
 void* ll_get(const linked_list* list, const void* key) {
   if (!list)
     return NULL;
-  ll_node* cur = list->head;
-  while (cur) {
-    int cmp = list->cmp(key, cur->key);
-    if (cmp == 0)
-      return cur->data;
-    if (cmp < 0)
-      return NULL; /* early exit due to sorting */
-    cur = cur->next;
-  }
-  return NULL;
+#ifdef CONTAINER_STATS
+  ll_statistics* stats = &((linked_list*)list)->stats;
+  size_t cmps = stats->cmps;
+#endif
+  ll_node* cur = ll_find(list, key, NULL);
+  void* data = cur && ll_cmp(list, key, cur->key) == 0 ? cur->data : NULL;
+#ifdef CONTAINER_STATS
+  stats->gets++;
+  stats->get_cmps += stats->cmps - cmps;
+#endif
+  return data;
 }
 
 int ll_remove(linked_list* list, const void* key) {
   if (!list || !list->head)
     return -1;
-  ll_node* cur = list->head;
-  while (cur) {
-    int cmp = list->cmp(key, cur->key);
-    if (cmp == 0) {
-      /* unlink node */
-      if (cur->prev)
-        cur->prev->next = cur->next;
-      else
-        list->head = cur->next;
-      if (cur->next)
-        cur->next->prev = cur->prev;
-      else
-        list->tail = cur->prev;
-      /* free owned resources */
-      if (list->free_key)
-        list->free_key(cur->key);
-      if (list->free_data)
-        list->free_data(cur->data);
-      free(cur);
-      list->size--;
-      return 0;
-    }
-    /* early exit because list is sorted */
-    if (cmp < 0)
-      return -1;
-    cur = cur->next;
+  ll_node* update[LL_MAX_LEVEL];
+  ll_node* cur = ll_find(list, key, update);
+  if (!cur || ll_cmp(list, key, cur->key) != 0)
+    return -1;
+  /* unlink node */
+  if (cur->prev)
+    cur->prev->next = cur->next;
+  else
+    list->head = cur->next;
+  if (cur->next)
+    cur->next->prev = cur->prev;
+  else
+    list->tail = cur->prev;
+  for (int l = 0; l < cur->level; l++) {
+    ll_node** link = update[l] ? &update[l]->skip[l] : &list->skip_head[l];
+    *link = cur->skip[l];
   }
-  return -1;
+  while (list->level > 0 && !list->skip_head[list->level - 1])
+    list->level--;
+  if (list->finger == cur)
+    list->finger = cur->prev;
+  /* free owned resources */
+  if (list->free_key)
+    list->free_key(cur->key);
+  if (list->free_data)
+    list->free_data(cur->data);
+  list->alloc.free(list->alloc.ctx, cur);
+  list->size--;
+  return 0;
 }
 
 void ll_foreach(const linked_list* list,
@@ -241,3 +460,55 @@ void ll_foreach_reverse(const linked_list* list,
 size_t ll_size(const linked_list* list) {
   return list ? list->size : 0;
 }
+
+/* Counters since ll_create; all zero unless built with CONTAINER_STATS */
+ll_statistics ll_stats(const linked_list* list) {
+  ll_statistics s;
+  memset(&s, 0, sizeof(s));
+#ifdef CONTAINER_STATS
+  if (list)
+    s = list->stats;
+#else
+  (void)list; /* unused */
+#endif
+  return s;
+}
+
+void ll_cursor_init(ll_cursor* cur, linked_list* list) {
+  if (!cur)
+    return;
+  cur->list = list;
+  cur->node = list ? list->head : NULL;
+}
+
+/* Moves to the first node not less than key. Returns 0, or -1 if there is
+   no such node and the cursor is past the end. */
+int ll_cursor_seek(ll_cursor* cur, const void* key) {
+  if (!cur || !cur->list)
+    return -1;
+  ll_node* n;
+  if (ll_find_near(cur->list, cur->node, key, &n) != 0)
+    n = ll_find(cur->list, key, NULL);
+  cur->node = n;
+  return n ? 0 : -1;
+}
+
+/* Advances to the next node. Returns 0, or -1 once past the end. */
+int ll_cursor_next(ll_cursor* cur) {
+  if (!cur || !cur->node)
+    return -1;
+  cur->node = cur->node->next;
+  return cur->node ? 0 : -1;
+}
+
+/* Inserts or replaces key, searching from the cursor, and moves the cursor
+   to its node. Returns 0 on success, -1 on failure. */
+int ll_cursor_insert(ll_cursor* cur, void* key, void* data) {
+  if (!cur || !cur->list)
+    return -1;
+  ll_node* n = ll_insert_near(cur->list, cur->node, key, data);
+  if (!n)
+    return -1;
+  cur->node = n;
+  return 0;
+}
@@ -2,6 +2,13 @@
 #define LINKEDLIST_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+/* Express levels above the node chain; with one node in four promoted per
+   level this covers lists of up to 4^16 nodes */
+#define LL_MAX_LEVEL 16
+/* Nodes walked from a finger before falling back to an indexed search */
+#define LL_FINGER_STEPS 8
 
 /* Function pointer types */
 /* Comparison function: <0 if a < b, =0 if a == b, >0 if a > b */
@@ -9,14 +16,42 @@ typedef int (*ll_cmp_func)(const void* a, const void* b);
 typedef void (*ll_free_func)(void* ptr);
 typedef void (*ll_iter_func)(void* key, void* value, void* user_data);
 
-/* Linked list node */
+/* Node allocator, ctx is passed to every call. alloc is asked for
+   LL_NODE_SIZE(level) bytes, the node and its tower. If release is set,
+   ll_destroy hands all nodes back at once instead of freeing each. */
+typedef struct ll_allocator {
+  void* (*alloc)(void* ctx, size_t size);
+  void (*free)(void* ctx, void* ptr);
+  void (*release)(void* ctx);
+  void* ctx;
+} ll_allocator;
+
+/* Linked list node. Nodes promoted to express levels carry a tower of
+   forward links in the same allocation, skip[i] being the next node on
+   level i + 1. */
 typedef struct ll_node {
   void* key;
   void* data;
   struct ll_node* prev;
   struct ll_node* next;
+  int level; /* number of express levels, 0 for plain nodes */
+  struct ll_node* skip[];
 } ll_node;
 
+/* Bytes allocated for a node with a tower of the given height */
+#define LL_NODE_SIZE(level) (sizeof(ll_node) + (level) * sizeof(ll_node*))
+
+/* Counters kept when built with CONTAINER_STATS (see ll_stats). cmps
+   counts every call of the comparison function, the others only those
+   made by ll_insert and ll_get. The counters are not synchronised. */
+typedef struct ll_statistics {
+  size_t inserts;
+  size_t insert_cmps;
+  size_t gets;
+  size_t get_cmps;
+  size_t cmps;
+} ll_statistics;
+
 /* Linked list */
 typedef struct linked_list {
   struct ll_node* head;
@@ -25,14 +60,41 @@ typedef struct linked_list {
   ll_cmp_func cmp;
   ll_free_func free_key;
   ll_free_func free_data;
+  ll_allocator alloc;
+  /* Skip list index over the sorted nodes */
+  struct ll_node* skip_head[LL_MAX_LEVEL];
+  int level; /* express levels in use */
+  uint64_t rng;
+  struct ll_node* finger; /* last inserted node, where the next search starts */
+#ifdef CONTAINER_STATS
+  ll_statistics stats;
+#endif
 } linked_list;
 
+/* Key and data handed to ll_bulk_insert */
+typedef struct ll_pair {
+  void* key;
+  void* data;
+} ll_pair;
+
+/* Position in a list: node is the current node, NULL past the end. A
+   cursor stays valid until its node is removed. */
+typedef struct ll_cursor {
+  linked_list* list;
+  ll_node* node;
+} ll_cursor;
+
 /* API */
 linked_list* ll_create(ll_cmp_func cmp,
                        ll_free_func free_key,
                        ll_free_func free_data);
+linked_list* ll_create_with_allocator(ll_cmp_func cmp,
+                                      ll_free_func free_key,
+                                      ll_free_func free_data,
+                                      const ll_allocator* alloc);
 void ll_destroy(linked_list* list);
 int ll_insert(linked_list* list, void* key, void* data);
+int ll_bulk_insert(linked_list* list, ll_pair* pairs, const size_t n);
 void* ll_get(const linked_list* list, const void* key);
 int ll_remove(linked_list* list, const void* key);
 void ll_foreach(const linked_list* list,
@@ -44,5 +106,15 @@ void ll_foreach_reverse(const linked_list* list,
                         const size_t limit,
                         void* user_data);
 size_t ll_size(const linked_list* list);
+ll_statistics ll_stats(const linked_list* list);
+
+/* Cursor API
+   Seeks and inserts start from the cursor's node and only fall back to an
+   indexed search when the key is not close by, so runs of nearby keys and
+   range scans cost O(1) per step. */
+void ll_cursor_init(ll_cursor* cur, linked_list* list);
+int ll_cursor_seek(ll_cursor* cur, const void* key);
+int ll_cursor_next(ll_cursor* cur);
+int ll_cursor_insert(ll_cursor* cur, void* key, void* data);
 
 #endif
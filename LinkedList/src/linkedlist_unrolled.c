@@ -0,0 +1,266 @@
+#include "linkedlist_unrolled.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Nodes below this count are merged with or refilled from a neighbour */
+#define UL_MIN_COUNT (UL_NODE_CAPACITY / 4)
+
+/* Internal Helpers */
+static ul_node* ul_node_new(unrolled_list* list, ul_node* after);
+static void ul_node_unlink(unrolled_list* list, ul_node* n);
+
+/* Moves count pairs from src starting at from to dst starting at to */
+static void ul_move(ul_node* dst,
+                    const size_t to,
+                    ul_node* src,
+                    const size_t from,
+                    const size_t count) {
+  memmove(&dst->keys[to], &src->keys[from], count * sizeof(void*));
+  memmove(&dst->data[to], &src->data[from], count * sizeof(void*));
+}
+
+/* First index in n whose key is not less than key */
+static size_t ul_lower_bound(const unrolled_list* list,
+                             const ul_node* n,
+                             const void* key) {
+  size_t lo = 0, hi = n->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (list->cmp(key, n->keys[mid]) > 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* Node that holds key if present: the first one whose last key is not
+   less than key, or the tail */
+static ul_node* ul_find_node(const unrolled_list* list, const void* key) {
+  ul_node* n = list->tail;
+  /* Keys past the end go to the tail without a walk (sorted loads) */
+  if (!n || list->cmp(key, n->keys[n->count - 1]) > 0)
+    return n;
+  n = list->head;
+  while (n && n->next && list->cmp(key, n->keys[n->count - 1]) > 0)
+    n = n->next;
+  return n;
+}
+
+unrolled_list* ul_create(ll_cmp_func cmp,
+                         ll_free_func free_key,
+                         ll_free_func free_data) {
+  if (!cmp)
+    return NULL;
+  unrolled_list* list = malloc(sizeof(*list));
+  if (!list)
+    return NULL;
+  list->pool = slab_create(sizeof(ul_node), SLAB_DEFAULT_OBJECTS / 8);
+  if (!list->pool) {
+    free(list);
+    return NULL;
+  }
+  list->head = list->tail = NULL;
+  list->size = 0;
+  list->cmp = cmp;
+  list->free_key = free_key;
+  list->free_data = free_data;
+  return list;
+}
+
+void ul_destroy(unrolled_list* list) {
+  if (!list)
+    return;
+  if (list->free_key || list->free_data) {
+    for (ul_node* n = list->head; n; n = n->next) {
+      for (size_t i = 0; i < n->count; i++) {
+        if (list->free_key)
+          list->free_key(n->keys[i]);
+        if (list->free_data)
+          list->free_data(n->data[i]);
+      }
+    }
+  }
+  /* Node memory goes back with the pool */
+  slab_destroy(list->pool);
+  free(list);
+}
+
+int ul_insert(unrolled_list* list, void* key, void* data) {
+  if (!list)
+    return -1;
+  ul_node* n = ul_find_node(list, key);
+  if (!n) {
+    n = ul_node_new(list, NULL);
+    if (!n)
+      return -1;
+  }
+  size_t pos = ul_lower_bound(list, n, key);
+  if (pos < n->count && list->cmp(key, n->keys[pos]) == 0) {
+    if (list->free_data)
+      list->free_data(n->data[pos]);
+    if (list->free_key)
+      list->free_key(n->keys[pos]);
+    n->keys[pos] = key;
+    n->data[pos] = data;
+    return 0;
+  }
+  if (n->count == UL_NODE_CAPACITY) {
+    ul_node* next = ul_node_new(list, n);
+    if (!next)
+      return -1;
+    if (pos == UL_NODE_CAPACITY && !next->next) {
+      /* Appending past the tail starts a new node, keeping sorted loads
+         at full nodes */
+      n = next;
+      pos = 0;
+    } else {
+      size_t half = UL_NODE_CAPACITY / 2;
+      ul_move(next, 0, n, half, UL_NODE_CAPACITY - half);
+      next->count = UL_NODE_CAPACITY - half;
+      n->count = half;
+      if (pos > half) {
+        n = next;
+        pos -= half;
+      }
+    }
+  }
+  ul_move(n, pos + 1, n, pos, n->count - pos);
+  n->keys[pos] = key;
+  n->data[pos] = data;
+  n->count++;
+  list->size++;
+  return 0;
+}
+
+void* ul_get(const unrolled_list* list, const void* key) {
+  if (!list)
+    return NULL;
+  ul_node* n = ul_find_node(list, key);
+  if (!n)
+    return NULL;
+  size_t pos = ul_lower_bound(list, n, key);
+  if (pos < n->count && list->cmp(key, n->keys[pos]) == 0)
+    return n->data[pos];
+  return NULL;
+}
+
+int ul_remove(unrolled_list* list, const void* key) {
+  if (!list || !list->head)
+    return -1;
+  ul_node* n = ul_find_node(list, key);
+  size_t pos = ul_lower_bound(list, n, key);
+  if (pos == n->count || list->cmp(key, n->keys[pos]) != 0)
+    return -1;
+  if (list->free_key)
+    list->free_key(n->keys[pos]);
+  if (list->free_data)
+    list->free_data(n->data[pos]);
+  ul_move(n, pos, n, pos + 1, n->count - pos - 1);
+  n->count--;
+  list->size--;
+  if (n->count >= UL_MIN_COUNT)
+    return 0;
+  /* Merge with a neighbour if both fit in three quarters of a node,
+     otherwise take half of the difference from it */
+  ul_node* other = n->next ? n->next : n->prev;
+  if (!other) {
+    if (n->count == 0)
+      ul_node_unlink(list, n);
+    return 0;
+  }
+  ul_node* left = other == n->next ? n : other;
+  ul_node* right = other == n->next ? other : n;
+  if (n->count + other->count <= UL_NODE_CAPACITY * 3 / 4) {
+    ul_move(left, left->count, right, 0, right->count);
+    left->count += right->count;
+    ul_node_unlink(list, right);
+    return 0;
+  }
+  size_t shift = (other->count - n->count) / 2;
+  if (other == right) {
+    ul_move(left, left->count, right, 0, shift);
+    ul_move(right, 0, right, shift, right->count - shift);
+    left->count += shift;
+    right->count -= shift;
+  } else {
+    ul_move(right, shift, right, 0, right->count);
+    ul_move(right, 0, left, left->count - shift, shift);
+    left->count -= shift;
+    right->count += shift;
+  }
+  return 0;
+}
+
+void ul_foreach(const unrolled_list* list,
+                ll_iter_func func,
+                const size_t limit,
+                void* user_data) {
+  if (!list || !func)
+    return;
+  size_t count = 0;
+  for (ul_node* n = list->head; n; n = n->next) {
+    for (size_t i = 0; i < n->count; i++) {
+      func(n->keys[i], n->data[i], user_data);
+      count++;
+      if (limit != 0)
+        if (count >= limit)
+          return;
+    }
+  }
+}
+
+void ul_foreach_reverse(const unrolled_list* list,
+                        ll_iter_func func,
+                        const size_t limit,
+                        void* user_data) {
+  if (!list || !func)
+    return;
+  size_t count = 0;
+  for (ul_node* n = list->tail; n; n = n->prev) {
+    for (size_t i = n->count; i-- > 0;) {
+      func(n->keys[i], n->data[i], user_data);
+      count++;
+      if (limit != 0)
+        if (count >= limit)
+          return;
+    }
+  }
+}
+
+size_t ul_size(const unrolled_list* list) {
+  return list ? list->size : 0;
+}
+
+/* Allocates an empty node and links it after the given one (at the head
+   if NULL) */
+static ul_node* ul_node_new(unrolled_list* list, ul_node* after) {
+  ul_node* n = slab_alloc(list->pool);
+  if (!n)
+    return NULL;
+  n->count = 0;
+  n->prev = after;
+  n->next = after ? after->next : list->head;
+  if (n->next)
+    n->next->prev = n;
+  else
+    list->tail = n;
+  if (after)
+    after->next = n;
+  else
+    list->head = n;
+  return n;
+}
+
+static void ul_node_unlink(unrolled_list* list, ul_node* n) {
+  if (n->prev)
+    n->prev->next = n->next;
+  else
+    list->head = n->next;
+  if (n->next)
+    n->next->prev = n->prev;
+  else
+    list->tail = n->prev;
+  slab_free(list->pool, n);
+}
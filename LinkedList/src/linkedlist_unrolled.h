@@ -0,0 +1,53 @@
+#ifndef LINKEDLIST_UNROLLED_H
+#define LINKEDLIST_UNROLLED_H
+
+#include <stddef.h>
+
+#include "linkedlist.h"
+#include "slab.h"
+
+/* Pairs per node. A node is split when it overflows and merged with (or
+   refilled from) a neighbour when it drops below a quarter. */
+#define UL_NODE_CAPACITY 32
+
+/* Unrolled list node, keys kept apart from data so lookups scan one
+   contiguous array */
+typedef struct ul_node {
+  struct ul_node* prev;
+  struct ul_node* next;
+  size_t count;
+  void* keys[UL_NODE_CAPACITY];
+  void* data[UL_NODE_CAPACITY];
+} ul_node;
+
+/* Sorted doubly linked list storing up to UL_NODE_CAPACITY sorted pairs
+   per node, with the same semantics as linked_list */
+typedef struct unrolled_list {
+  ul_node* head;
+  ul_node* tail;
+  size_t size;
+  ll_cmp_func cmp;
+  ll_free_func free_key;
+  ll_free_func free_data;
+  slab_pool* pool;
+} unrolled_list;
+
+/* API */
+unrolled_list* ul_create(ll_cmp_func cmp,
+                         ll_free_func free_key,
+                         ll_free_func free_data);
+void ul_destroy(unrolled_list* list);
+int ul_insert(unrolled_list* list, void* key, void* data);
+void* ul_get(const unrolled_list* list, const void* key);
+int ul_remove(unrolled_list* list, const void* key);
+void ul_foreach(const unrolled_list* list,
+                ll_iter_func func,
+                const size_t limit,
+                void* user_data);
+void ul_foreach_reverse(const unrolled_list* list,
+                        ll_iter_func func,
+                        const size_t limit,
+                        void* user_data);
+size_t ul_size(const unrolled_list* list);
+
+#endif
@@ -2,20 +2,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "dict.h"
 #include "linkedlist.h"
+#include "linkedlist_unrolled.h"
 
 typedef struct {
   char* id;
   double score;
 } record_t;
 
-typedef struct {
-  char* trad;
-  char* simp;
-  char* pinyin;
-  char* translation;
-} ChineseDictEntry;
-
 char* xstrdup(const char* s);
 int int_cmp(const void* a, const void* b);
 int str_cmp(const void* a, const void* b);
@@ -23,10 +18,11 @@ void print_item_1(void* key, void* data, void* user_data);
 void print_item_2(void* key, void* data, void* user_data);
 void print_chin(void* key, void* data, void* user_data);
 void record_free(void* ptr);
-void free_chin(void* ptr);
 void example1(void);
 void example2(void);
 void example3(void);
+void example4(void);
+void example5(void);
 int main(void);
 
 char* xstrdup(const char* s) {
@@ -42,6 +38,9 @@ int int_cmp(const void* a, const void* b) {
 }
 
 int str_cmp(const void* a, const void* b) {
+  /* Interned keys are equal exactly when their pointers are */
+  if (a == b)
+    return 0;
   const char* sa = a;
   const char* sb = b;
   return strcmp(sa, sb);
@@ -73,15 +72,6 @@ void record_free(void* data) {
   free(data);
 }
 
-void free_chin(void* ptr) {
-  ChineseDictEntry* d = ptr;
-  free(d->trad);
-  free(d->simp);
-  free(d->pinyin);
-  free(d->translation);
-  free(d);
-}
-
 void example1(void) {
   linked_list* list = ll_create(int_cmp, free, free);
 
@@ -188,55 +178,39 @@ void example2(void) {
 void example3(void) {
   puts("Example 3\n-------");
 
-  linked_list* chin = ll_create(str_cmp, free, free_chin);
+  linked_list* chin = ll_create(str_cmp, NULL, NULL);
   if (!chin) {
     fprintf(stderr, "Failed to create\n");
     abort();
   }
 
-  FILE* fp = fopen("data/handedict-x.txt", "r");
-  char* line = NULL;
-  size_t len = 0;
-
-  if (fp == NULL) {
-    perror("Failed to open file");
+  /* Keys and entries point into the loaded file, parsed on all CPUs */
+  dict_file* dict = dict_load_parallel("data/handedict-x.txt", 0);
+  if (!dict) {
+    perror("Failed to load file");
     abort();
   }
-
-  while (getline(&line, &len, fp) != -1) {
-    line[strcspn(line, "\n")] = '\0';
-
-    char* field = line;
-    char* tab;
-    ChineseDictEntry* d = malloc(sizeof(ChineseDictEntry));
-
-    d->trad = NULL;
-    d->simp = NULL;
-    d->pinyin = NULL;
-    d->translation = NULL;
-    int index = 0;
-
-    while ((tab = strchr(field, '\t'))) {
-      *tab = '\0';
-      index++;
-      switch (index) {
-        case 1:
-          d->trad = xstrdup(field);
-          break;
-        case 2:
-          d->simp = xstrdup(field);
-          break;
-        case 3:
-          d->pinyin = xstrdup(field);
-          break;
-      }
-      field = tab + 1;
-    }
-    d->translation = xstrdup(field);
-    ll_insert(chin, xstrdup(d->trad), d);
+  /* Repeated keys, and simplified forms equal to them, share one pointer */
+  intern_pool* pool = intern_create(dict->count);
+  if (!pool || dict_intern(dict, pool) != 0) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  size_t count = dict->count;
+  ll_pair* pairs = malloc(count * sizeof(ll_pair));
+  if (!pairs) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  for (size_t i = 0; i < count; i++) {
+    pairs[i].key = dict->entries[i].trad;
+    pairs[i].data = &dict->entries[i];
   }
-  free(line);
-  fclose(fp);
+
+  /* The pairs are merge sorted, where halves already in order are not
+     merged again, and then linked into the list in one pass */
+  ll_bulk_insert(chin, pairs, count);
+  free(pairs);
 
   const char* key1 = "擊鼓";
   ChineseDictEntry* found = ll_get(chin, key1);
@@ -292,12 +266,86 @@ void example3(void) {
   printf("-------\nSize: %ld\n", ll_size(chin));
   puts("-------");
 
+#ifdef CONTAINER_STATS
+  ll_statistics st = ll_stats(chin);
+  printf("Comparisons: %zu, per ll_insert: %.1f, per ll_get: %.1f\n-------\n",
+         st.cmps, st.inserts ? (double)st.insert_cmps / st.inserts : 0.0,
+         st.gets ? (double)st.get_cmps / st.gets : 0.0);
+#endif
+
   ll_destroy(chin);
+  intern_destroy(pool);
+  dict_free(dict);
+}
+
+void example4(void) {
+  linked_list* list = ll_create(int_cmp, free, free);
+  ll_cursor cur;
+  char buf[32];
+
+  puts("EXAMPLE 4\n-------");
+
+  /* Runs of nearby keys are inserted through a cursor */
+  ll_cursor_init(&cur, list);
+  for (int run = 0; run < 3; ++run) {
+    for (int i = 0; i < 4; ++i) {
+      int* k = malloc(sizeof(int));
+      *k = run * 100 + i * 10;
+      snprintf(buf, sizeof(buf), "value-%d", *k);
+      ll_cursor_insert(&cur, k, xstrdup(buf));
+    }
+  }
+
+  ll_foreach(list, print_item_1, 0, NULL);
+  puts("-------");
+
+  /* Range scan from the first key not less than 105 */
+  puts("Range [105, 220]:");
+  int from = 105;
+  for (int r = ll_cursor_seek(&cur, &from);
+       r == 0 && *(int*)cur.node->key <= 220; r = ll_cursor_next(&cur))
+    print_item_1(cur.node->key, cur.node->data, NULL);
+  puts("-------");
+
+  ll_destroy(list);
+}
+
+void example5(void) {
+  unrolled_list* list = ul_create(int_cmp, free, free);
+  char buf[32];
+
+  puts("EXAMPLE 5\n-------");
+
+  /* Enough keys to fill and split several nodes */
+  for (int i = 0; i < 100; ++i) {
+    int* k = malloc(sizeof(int));
+    *k = (i * 37) % 100;
+    snprintf(buf, sizeof(buf), "value-%d", *k);
+    ul_insert(list, k, xstrdup(buf));
+  }
+  for (int i = 0; i < 100; i += 2)
+    ul_remove(list, &i);
+
+  puts("The first 5 items:");
+  ul_foreach(list, print_item_1, 5, NULL);
+  puts("-------");
+
+  puts("The last 5 items:");
+  ul_foreach_reverse(list, print_item_1, 5, NULL);
+  puts("-------");
+
+  int kk = 37;
+  printf("Find %d = %s\n-------\n", kk, (char*)ul_get(list, &kk));
+  printf("Size: %ld\n-------\n", ul_size(list));
+
+  ul_destroy(list);
 }
 
 int main(void) {
   example1();
   example2();
   example3();
+  example4();
+  example5();
   return 0;
 }
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "linkedlist.h"
+#include "suite.h"
+
+const char* const suite_container = "linked_list";
+const char* const suite_dict_path = "data/handedict-x.txt";
+
+static linked_list* create(void) {
+  linked_list* list = ll_create(suite_str_cmp, NULL, NULL);
+  if (!list) {
+    fprintf(stderr, "Failed to create linked list\n");
+    abort();
+  }
+  return list;
+}
+
+static void count_node(void* key, void* data, void* user_data) {
+  (void)key;  /* unused */
+  (void)data; /* unused */
+  (*(size_t*)user_data)++;
+}
+
+static void run_insert(const suite_keys* k, char** keys, const char* name) {
+  if (!suite_enabled(name))
+    return;
+  linked_list* list = create();
+  suite_begin();
+  for (size_t i = 0; i < k->n; i++)
+    ll_insert(list, keys[i], keys[i]);
+  suite_end(k, name, k->n);
+  ll_destroy(list);
+}
+
+/* Example 3: the lines as key/data pairs, linked by ll_bulk_insert */
+void* suite_fill_dict(ChineseDictEntry* entries, const size_t n) {
+  ll_pair* pairs = malloc((n ? n : 1) * sizeof(ll_pair));
+  if (!pairs) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  for (size_t i = 0; i < n; i++) {
+    pairs[i].key = entries[i].trad;
+    pairs[i].data = &entries[i];
+  }
+  linked_list* list = create();
+  ll_bulk_insert(list, pairs, n);
+  free(pairs);
+  return list;
+}
+
+void suite_free_dict(void* container) {
+  ll_destroy(container);
+}
+
+/* Lookups go through the keys backwards, so not in insertion order. The
+   sort workload is ll_bulk_insert of the keys in random order, which
+   merge sorts them before linking. */
+void suite_run(const suite_keys* k) {
+  size_t n = k->n;
+  run_insert(k, k->random, "insert_random");
+  run_insert(k, k->sorted, "insert_sequential");
+
+  if (suite_enabled("sort")) {
+    ll_pair* pairs = malloc((n ? n : 1) * sizeof(ll_pair));
+    if (!pairs) {
+      fprintf(stderr, "Out of memory\n");
+      abort();
+    }
+    for (size_t i = 0; i < n; i++) {
+      pairs[i].key = k->random[i];
+      pairs[i].data = k->random[i];
+    }
+    linked_list* list = create();
+    suite_begin();
+    ll_bulk_insert(list, pairs, n);
+    suite_end(k, "sort", n);
+    ll_destroy(list);
+    free(pairs);
+  }
+
+  linked_list* list = create();
+  for (size_t i = 0; i < n; i++)
+    ll_insert(list, k->sorted[i], k->sorted[i]);
+
+  if (suite_enabled("get_hit")) {
+    size_t found = 0;
+    suite_begin();
+    for (size_t i = n; i-- > 0;)
+      found += ll_get(list, k->random[i]) != NULL;
+    suite_end(k, "get_hit", n);
+    if (found != n)
+      fprintf(stderr, "get_hit: %zu of %zu found\n", found, n);
+  }
+
+  if (suite_enabled("get_miss")) {
+    size_t found = 0;
+    suite_begin();
+    for (size_t i = n; i-- > 0;)
+      found += ll_get(list, k->misses[i]) != NULL;
+    suite_end(k, "get_miss", n);
+    if (found != 0)
+      fprintf(stderr, "get_miss: %zu found\n", found);
+  }
+
+  if (suite_enabled("iterate")) {
+    size_t count = 0;
+    suite_begin();
+    ll_foreach(list, count_node, 0, &count);
+    suite_end(k, "iterate", count);
+  }
+
+  if (suite_enabled("remove")) {
+    suite_begin();
+    for (size_t i = n; i-- > 0;)
+      ll_remove(list, k->random[i]);
+    suite_end(k, "remove", n);
+    if (ll_size(list) != 0)
+      fprintf(stderr, "remove: %zu nodes left\n", ll_size(list));
+  }
+
+  ll_destroy(list);
+}
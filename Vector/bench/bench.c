@@ -0,0 +1,477 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "vector.h"
+
+#define BENCH_RESORT_ROUNDS 10
+#define BENCH_RESORT_APPEND 10
+#define BENCH_MIXED_OPS 10000
+#define BENCH_MIXED_TAIL 64
+#define BENCH_SEARCH_OPS 1000000
+#define BENCH_RADIX_U64 10000000
+#define BENCH_DICT_ROUNDS 20
+#define BENCH_DICT_PATH "data/handedict.txt"
+#define BENCH_PURGE_N 100000
+#define BENCH_PURGE_EVERY 10
+
+/* ---------- Helpers ---------- */
+
+double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+int str_cmp(const void* a, const void* b) {
+  if (a == b)
+    return 0;
+  return strcmp((const char*)a, (const char*)b);
+}
+
+/* First eight bytes, big endian and zero padded, so prefixes are ordered
+   like strcmp */
+uint64_t str_prefix(const void* key) {
+  const unsigned char* s = key;
+  uint64_t p = 0;
+  for (int i = 0; i < 8; i++) {
+    p <<= 8;
+    if (*s)
+      p |= *s++;
+  }
+  return p;
+}
+
+/* Random keys in random order; every key occurs twice, so the sort
+   results also show whether equal keys kept their order */
+char** make_keys(const size_t n, const char* prefix) {
+  char** keys = malloc(n * sizeof(char*));
+  char buf[64];
+  for (size_t i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "%s%016llx", prefix,
+             (unsigned long long)splitmix64(splitmix64(i) % (n / 2 + 1)));
+    keys[i] = malloc(strlen(buf) + 1);
+    strcpy(keys[i], buf);
+  }
+  return keys;
+}
+
+void free_keys(char** keys, const size_t n) {
+  for (size_t i = 0; i < n; i++)
+    free(keys[i]);
+  free(keys);
+}
+
+void report(const char* name, const size_t ops, const double ns) {
+  printf("%-28s %10zu ops %10.1f ns/op %10.1f ms\n", name, ops,
+         ns / (double)ops, ns / 1e6);
+}
+
+/* ---------- Workloads ---------- */
+
+/* Fills vec with the keys, values being the original positions counted
+   from 1, so that no value is NULL */
+static void fill(vector* vec, char** keys, const size_t n) {
+  vector_clear(vec);
+  for (size_t i = 0; i < n; i++)
+    vector_push_back(vec, keys[i], (void*)(uintptr_t)(i + 1));
+}
+
+/* Sorted by key, and equal keys still in their original order */
+static int check_stable(const vector* vec) {
+  for (size_t i = 1; i < vec->size; i++) {
+    int c = str_cmp(vec->data[i - 1].key, vec->data[i].key);
+    if (c > 0 || (c == 0 && vec->data[i - 1].value >= vec->data[i].value))
+      return 0;
+  }
+  return 1;
+}
+
+void bench_sort(char** keys, const size_t n, const size_t max_threads) {
+  vector* vec = vector_create(n, str_cmp, NULL);
+  if (!vec) {
+    fprintf(stderr, "Failed to create vector\n");
+    abort();
+  }
+
+  fill(vec, keys, n);
+  double t = now_ns();
+  vector_sort_stable(vec);
+  double base = now_ns() - t;
+  report("vector_sort_stable", n, base);
+  if (!check_stable(vec))
+    fprintf(stderr, "vector_sort_stable: not sorted or not stable\n");
+
+  char name[64];
+  for (size_t threads = 1;; threads *= 2) {
+    if (threads > max_threads)
+      threads = max_threads;
+    fill(vec, keys, n);
+    t = now_ns();
+    vector_sort_parallel(vec, threads);
+    t = now_ns() - t;
+    snprintf(name, sizeof(name), "vector_sort_parallel (%zu)", threads);
+    report(name, n, t);
+    printf("%-28s %10.2fx\n", "  speedup", base / t);
+    if (!check_stable(vec))
+      fprintf(stderr, "%s: not sorted or not stable\n", name);
+    if (threads == max_threads)
+      break;
+  }
+
+  vector_destroy(vec);
+}
+
+/* Sorts once, then repeatedly appends a few keys and sorts again; with
+   natural runs and the cached scratch buffer the re-sorts are close to a
+   linear pass */
+void bench_resort(char** keys, const size_t n) {
+  size_t base = n - BENCH_RESORT_ROUNDS * BENCH_RESORT_APPEND;
+  vector* vec = vector_create(n, str_cmp, NULL);
+  if (!vec || n < BENCH_RESORT_ROUNDS * BENCH_RESORT_APPEND) {
+    fprintf(stderr, "Failed to create vector\n");
+    abort();
+  }
+  fill(vec, keys, base);
+  vector_sort_stable(vec);
+
+  double t = now_ns();
+  for (size_t r = 0; r < BENCH_RESORT_ROUNDS; r++) {
+    for (size_t i = 0; i < BENCH_RESORT_APPEND; i++) {
+      size_t k = base + r * BENCH_RESORT_APPEND + i;
+      vector_push_back(vec, keys[k], (void*)(uintptr_t)(k + 1));
+    }
+    vector_sort_stable(vec);
+  }
+  t = now_ns() - t;
+  report("re-sort after 10 appends", n * BENCH_RESORT_ROUNDS, t);
+  if (!check_stable(vec))
+    fprintf(stderr, "re-sort: not sorted or not stable\n");
+  vector_destroy(vec);
+}
+
+/* Alternating inserts and lookups on a sorted vector. Modes: push_back
+   with a sort before every lookup, vector_insert_sorted, and buffered
+   mode with an unsorted tail. */
+void bench_mixed(char** keys, const size_t n) {
+  const char* names[] = {"mixed: push_back + sort", "mixed: insert_sorted",
+                         "mixed: buffered"};
+  size_t base = n > BENCH_MIXED_OPS ? n - BENCH_MIXED_OPS : 0;
+  for (int mode = 0; mode < 3; mode++) {
+    vector* vec = vector_create(n, str_cmp, NULL);
+    if (!vec) {
+      fprintf(stderr, "Failed to create vector\n");
+      abort();
+    }
+    fill(vec, keys, base);
+    vector_sort_stable(vec);
+    if (mode == 2)
+      vector_set_buffered(vec, BENCH_MIXED_TAIL);
+
+    size_t found = 0;
+    double t = now_ns();
+    for (size_t i = base; i < n; i++) {
+      if (mode == 1)
+        vector_insert_sorted(vec, keys[i], keys[i]);
+      else
+        vector_push_back(vec, keys[i], keys[i]);
+      if (mode == 0)
+        vector_sort_stable(vec);
+      found += vector_binary_search(vec, keys[(i * 7919) % (i + 1)]) != NULL;
+    }
+    report(names[mode], n - base, now_ns() - t);
+    if (found != n - base)
+      fprintf(stderr, "%s: expected %zu hits, got %zu\n", names[mode],
+              n - base, found);
+    vector_destroy(vec);
+  }
+}
+
+/* Random lookups of present and absent keys, with the plain binary search
+   and through the Eytzinger index. The keys get no common prefix here, so
+   their first eight bytes tell most of them apart. */
+void bench_search(const size_t n) {
+  char** keys = make_keys(n, "");
+  char** misses = make_keys(n, "~");
+  vector* vec = vector_create(n, str_cmp, NULL);
+  if (!vec) {
+    fprintf(stderr, "Failed to create vector\n");
+    abort();
+  }
+  for (size_t i = 0; i < n; i++)
+    vector_push_back(vec, keys[i], keys[i]);
+  vector_sort_stable(vec);
+
+  const char* names[] = {"vector_binary_search", "vector_index_search"};
+  for (int indexed = 0; indexed < 2; indexed++) {
+    if (indexed) {
+      vector_set_index(vec, str_prefix);
+      double t = now_ns();
+      vector_index_search(vec, keys[0]);
+      report("  index build", n, now_ns() - t);
+    }
+    size_t found = 0;
+    double t = now_ns();
+    for (size_t i = 0; i < BENCH_SEARCH_OPS; i++) {
+      uint64_t r = splitmix64(i);
+      const char* key = r & 1 ? keys[(r >> 1) % n] : misses[(r >> 1) % n];
+      void* v = indexed ? vector_index_search(vec, key)
+                        : vector_binary_search(vec, key);
+      found += (v != NULL) != !(r & 1);
+    }
+    report(names[indexed], BENCH_SEARCH_OPS, now_ns() - t);
+    if (found != BENCH_SEARCH_OPS)
+      fprintf(stderr, "%s: %zu wrong results\n", names[indexed],
+              BENCH_SEARCH_OPS - found);
+  }
+
+  vector_destroy(vec);
+  free_keys(keys, n);
+  free_keys(misses, n);
+}
+
+/* Sort and lookups with key pointers only and with inline key prefixes,
+   on keys without a common prefix */
+void bench_inline(const size_t n) {
+  char** keys = make_keys(n, "");
+  vector* vec = vector_create(n, str_cmp, NULL);
+  if (!vec) {
+    fprintf(stderr, "Failed to create vector\n");
+    abort();
+  }
+
+  const char* names[][2] = {{"sort: key pointers", "search: key pointers"},
+                            {"sort: inline prefix", "search: inline prefix"}};
+  for (int mode = 0; mode < 2; mode++) {
+    vector_set_inline_prefix(vec, mode ? str_prefix : NULL, 0);
+    fill(vec, keys, n);
+    double t = now_ns();
+    vector_sort_stable(vec);
+    report(names[mode][0], n, now_ns() - t);
+    if (!check_stable(vec))
+      fprintf(stderr, "%s: not sorted or not stable\n", names[mode][0]);
+
+    size_t found = 0;
+    t = now_ns();
+    for (size_t i = 0; i < BENCH_SEARCH_OPS; i++)
+      found += vector_binary_search(vec, keys[splitmix64(i) % n]) != NULL;
+    report(names[mode][1], BENCH_SEARCH_OPS, now_ns() - t);
+    if (found != BENCH_SEARCH_OPS)
+      fprintf(stderr, "%s: %zu keys not found\n", names[mode][1],
+              BENCH_SEARCH_OPS - found);
+  }
+
+  vector_destroy(vec);
+  free_keys(keys, n);
+}
+
+static int u64_cmp(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static uint64_t u64_prefix(const void* key) {
+  return *(const uint64_t*)key;
+}
+
+/* First field of every dictionary line, NULL if the file is missing */
+static char** load_dict_keys(const char* path, size_t* n) {
+  FILE* fp = fopen(path, "r");
+  if (!fp)
+    return NULL;
+  size_t cap = 1024;
+  char** keys = malloc(cap * sizeof(char*));
+  char* line = NULL;
+  size_t len = 0;
+  *n = 0;
+  while (getline(&line, &len, fp) != -1) {
+    line[strcspn(line, "\t\n")] = '\0';
+    if (*n == cap) {
+      cap *= 2;
+      keys = realloc(keys, cap * sizeof(char*));
+    }
+    keys[*n] = malloc(strlen(line) + 1);
+    strcpy(keys[(*n)++], line);
+  }
+  free(line);
+  fclose(fp);
+  return keys;
+}
+
+/* Sorts the keys with vector_sort_stable and with vector_sort_radix
+   (with the given inline prefix), and checks both give the same order */
+static void radix_vs_stable(const char* name,
+                            void** keys,
+                            const size_t n,
+                            vec_key_cmp_func cmp,
+                            vec_key_prefix_func prefix,
+                            const vec_radix_kind kind,
+                            const size_t rounds) {
+  vector* a = vector_create(n, cmp, NULL);
+  vector* b = vector_create(n, cmp, NULL);
+  if (!a || !b) {
+    fprintf(stderr, "Failed to create vector\n");
+    abort();
+  }
+  vector_set_inline_prefix(b, prefix, prefix != NULL);
+
+  double stable = 0, radix = 0;
+  for (size_t r = 0; r < rounds; r++) {
+    vector_clear(a);
+    vector_clear(b);
+    for (size_t i = 0; i < n; i++) {
+      vector_push_back(a, keys[i], (void*)(uintptr_t)i);
+      vector_push_back(b, keys[i], (void*)(uintptr_t)i);
+    }
+    double t = now_ns();
+    vector_sort_stable(a);
+    stable += now_ns() - t;
+    t = now_ns();
+    vector_sort_radix(b, kind);
+    radix += now_ns() - t;
+  }
+  char label[64];
+  snprintf(label, sizeof(label), "%s: stable", name);
+  report(label, n * rounds, stable);
+  snprintf(label, sizeof(label), "%s: radix", name);
+  report(label, n * rounds, radix);
+  for (size_t i = 0; i < n; i++) {
+    if (a->data[i].key != b->data[i].key ||
+        a->data[i].value != b->data[i].value) {
+      fprintf(stderr, "%s: radix order differs at %zu\n", name, i);
+      break;
+    }
+  }
+  vector_destroy(a);
+  vector_destroy(b);
+}
+
+/* Radix against merge sort on the dictionary keys (UTF-8), the string
+   keys and random 64 bit integers (inline as exact prefixes) */
+void bench_radix(char** keys, const size_t n) {
+  size_t dict_n;
+  char** dict = load_dict_keys(BENCH_DICT_PATH, &dict_n);
+  if (dict) {
+    radix_vs_stable("handedict", (void**)dict, dict_n, str_cmp, NULL,
+                    VEC_RADIX_STRING, BENCH_DICT_ROUNDS);
+    /* The file is mostly in order, which suits the natural merge sort */
+    for (size_t i = dict_n; i > 1; i--) {
+      size_t j = splitmix64(i) % i;
+      char* swap = dict[i - 1];
+      dict[i - 1] = dict[j];
+      dict[j] = swap;
+    }
+    radix_vs_stable("handedict shuffled", (void**)dict, dict_n, str_cmp,
+                    NULL, VEC_RADIX_STRING, BENCH_DICT_ROUNDS);
+    free_keys(dict, dict_n);
+  } else {
+    printf("%s not found, skipping the dictionary keys\n", BENCH_DICT_PATH);
+  }
+
+  radix_vs_stable("string keys", (void**)keys, n, str_cmp, NULL,
+                  VEC_RADIX_STRING, 1);
+
+  uint64_t* values = malloc(BENCH_RADIX_U64 * sizeof(uint64_t));
+  void** ints = malloc(BENCH_RADIX_U64 * sizeof(void*));
+  if (!values || !ints) {
+    fprintf(stderr, "Failed to allocate keys\n");
+    abort();
+  }
+  for (size_t i = 0; i < BENCH_RADIX_U64; i++) {
+    values[i] = splitmix64(i);
+    ints[i] = &values[i];
+  }
+  radix_vs_stable("uint64 keys", ints, BENCH_RADIX_U64, u64_cmp, u64_prefix,
+                  VEC_RADIX_PREFIX, 1);
+  free(ints);
+  free(values);
+}
+
+/* Every BENCH_PURGE_EVERY-th element (by original position) expired */
+static int expired(void* key, void* value, void* user_data) {
+  (void)key;       /* unused */
+  (void)user_data; /* unused */
+  return (uintptr_t)value % BENCH_PURGE_EVERY == 0;
+}
+
+/* Purge of expired elements, one vector_delete each against one
+   vector_delete_if pass. The per-index loop is quadratic, so it runs on
+   at most BENCH_PURGE_N elements. */
+void bench_purge(char** keys, const size_t n) {
+  vector* vec = vector_create(n, str_cmp, NULL);
+  if (!vec) {
+    fprintf(stderr, "Failed to create vector\n");
+    abort();
+  }
+  size_t small = n < BENCH_PURGE_N ? n : BENCH_PURGE_N;
+  size_t expect = small - (small + BENCH_PURGE_EVERY - 1) / BENCH_PURGE_EVERY;
+
+  fill(vec, keys, small);
+  double t = now_ns();
+  for (size_t i = 0; i < vec->size;) {
+    if (expired(vec->data[i].key, vec->data[i].value, NULL))
+      vector_delete(vec, i);
+    else
+      i++;
+  }
+  report("purge: vector_delete loop", small, now_ns() - t);
+  if (vec->size != expect)
+    fprintf(stderr, "purge: %zu elements left, expected %zu\n", vec->size,
+            expect);
+
+  char name[64];
+  for (size_t m = small;; m = n) {
+    fill(vec, keys, m);
+    t = now_ns();
+    vector_delete_if(vec, expired, NULL);
+    snprintf(name, sizeof(name), "purge: delete_if (%zu)", m);
+    report(name, m, now_ns() - t);
+    if (m == n)
+      break;
+  }
+
+  /* Dropping most elements with auto shrink gives the memory back */
+  vector_set_auto_shrink(vec, 1);
+  vector_delete_range(vec, 0, vec->size - vec->size / 100);
+  printf("%-28s %10zu elements, capacity %zu\n", "purge: auto shrink",
+         vec->size, vec->capacity);
+  vector_destroy(vec);
+}
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_N;
+  if (n == 0)
+    n = BENCH_DEFAULT_N;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t threads = argc > 2 ? strtoul(argv[2], NULL, 10) : (size_t)cpus;
+  if (threads == 0)
+    threads = 1;
+
+  char** keys = make_keys(n, "key-");
+
+  printf("Vector benchmark, %zu string keys\n", n);
+  bench_sort(keys, n, threads);
+  bench_resort(keys, n);
+  bench_mixed(keys, n);
+  bench_search(n);
+  bench_inline(n);
+  bench_radix(keys, n);
+  bench_purge(keys, n);
+
+  free_keys(keys, n);
+  return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BENCH_DEFAULT_N 1000000
+
+/* Helpers */
+double now_ns(void);
+uint64_t splitmix64(uint64_t x);
+int str_cmp(const void* a, const void* b);
+uint64_t str_prefix(const void* key);
+char** make_keys(const size_t n, const char* prefix);
+void free_keys(char** keys, const size_t n);
+void report(const char* name, const size_t ops, const double ns);
+
+/* Workloads */
+void bench_sort(char** keys, const size_t n, const size_t max_threads);
+void bench_resort(char** keys, const size_t n);
+void bench_mixed(char** keys, const size_t n);
+void bench_search(const size_t n);
+void bench_inline(const size_t n);
+void bench_radix(char** keys, const size_t n);
+void bench_purge(char** keys, const size_t n);
+int main(int argc, char** argv);
+
+#endif
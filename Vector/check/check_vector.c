@@ -0,0 +1,768 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vector.h"
+
+/* Randomized checks of the vector against a reference array. The
+   reference holds the same elements in the order the vector must have
+   them, and every element carries a heap tag as its value, so both the
+   order of equal keys (stability) and the vector's ownership of values
+   can be checked. */
+
+#define CHECK_KEYS 4096
+#define CHECK_DEFAULT_OPS 200000
+/* Longest vector the passes build */
+#define CHECK_MAX_SORT 3000
+/* Operations between two full checks of the elements */
+#define CHECK_EVERY 97
+/* Longest string key, terminator included */
+#define CHECK_STR_LEN 12
+
+int main(int argc, char** argv);
+
+typedef struct check_item {
+  int key;
+  uintptr_t tag;
+  size_t pos; /* position before a reference sort */
+} check_item;
+
+/* Reference: the elements in the order the vector holds them */
+typedef struct check_ref {
+  check_item* items;
+  size_t size;
+  size_t cap;
+} check_ref;
+
+static int key_vals[CHECK_KEYS];
+static char str_keys[CHECK_KEYS][CHECK_STR_LEN];
+static uint64_t rng_state;
+static long live_data; /* values not freed yet */
+static uintptr_t next_tag;
+
+/* ---------- Helpers ---------- */
+
+static uint64_t rng_next(void) {
+  uint64_t x = (rng_state += 0x9e3779b97f4a7c15ULL);
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static size_t rng_below(const size_t n) {
+  return (size_t)(rng_next() % n);
+}
+
+static void fail(const char* pass, const char* what, const size_t op) {
+  fprintf(stderr, "%s: %s (after %zu ops)\n", pass, what, op);
+  abort();
+}
+
+static int int_cmp(const void* a, const void* b) {
+  int ia = *(const int*)a;
+  int ib = *(const int*)b;
+  return (ia > ib) - (ia < ib);
+}
+
+static int str_cmp(const void* a, const void* b) {
+  return strcmp((const char*)a, (const char*)b);
+}
+
+/* String keys from a few letters and a byte above 0x7f, of every length
+   up to CHECK_STR_LEN - 1 and often sharing a long prefix with each
+   other, so the radix sort recurses deep and meets strings ending at
+   every depth. Some are equal. */
+static void make_str_keys(void) {
+  static const char letters[] = {'a', 'b', 'c', (char)0xe4};
+  for (int k = 0; k < CHECK_KEYS; k++) {
+    size_t len = rng_below(CHECK_STR_LEN);
+    size_t shared = k > 0 ? rng_below(len + 1) : 0;
+    for (size_t i = 0; i < len; i++)
+      str_keys[k][i] = i < shared && str_keys[k - 1][i]
+                           ? str_keys[k - 1][i]
+                           : letters[rng_below(sizeof(letters))];
+    str_keys[k][len] = '\0';
+  }
+}
+
+/* Values are heap tags, freed by the vector */
+static uintptr_t* make_value(void) {
+  uintptr_t* v = malloc(sizeof(uintptr_t));
+  if (!v) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  *v = ++next_tag;
+  live_data++;
+  return v;
+}
+
+static void free_elem(void* key, void* value) {
+  (void)key; /* keys point into key_vals */
+  live_data--;
+  free(value);
+}
+
+static vector* make_vector(const char* pass) {
+  vector* vec = vector_create(1 + rng_below(16), int_cmp, free_elem);
+  if (!vec)
+    fail(pass, "vector_create failed", 0);
+  return vec;
+}
+
+static void ref_reserve(check_ref* ref, const size_t n) {
+  if (n <= ref->cap)
+    return;
+  size_t cap = ref->cap ? ref->cap : 64;
+  while (cap < n)
+    cap *= 2;
+  check_item* p = realloc(ref->items, cap * sizeof(check_item));
+  if (!p) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  ref->items = p;
+  ref->cap = cap;
+}
+
+/* Appends key with a new value to both vector and reference */
+static void push(vector* vec,
+                 check_ref* ref,
+                 const int key,
+                 const char* pass) {
+  uintptr_t* v = make_value();
+  if (vector_push_back(vec, &key_vals[key], v) != 0)
+    fail(pass, "vector_push_back failed", ref->size);
+  ref_reserve(ref, ref->size + 1);
+  ref->items[ref->size++] = (check_item){key, *v, 0};
+}
+
+static int item_cmp(const void* a, const void* b) {
+  const check_item* x = a;
+  const check_item* y = b;
+  if (x->key != y->key)
+    return x->key < y->key ? -1 : 1;
+  return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+/* Reference items whose keys index str_keys */
+static int str_item_cmp(const void* a, const void* b) {
+  const check_item* x = a;
+  const check_item* y = b;
+  int c = strcmp(str_keys[x->key], str_keys[y->key]);
+  if (c != 0)
+    return c;
+  return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+/* Stable sort of the reference: ties keep their current order */
+static void ref_sort(check_ref* ref) {
+  for (size_t i = 0; i < ref->size; i++)
+    ref->items[i].pos = i;
+  if (ref->size > 1)
+    qsort(ref->items, ref->size, sizeof(check_item), item_cmp);
+}
+
+static void ref_sort_strings(check_ref* ref) {
+  for (size_t i = 0; i < ref->size; i++)
+    ref->items[i].pos = i;
+  if (ref->size > 1)
+    qsort(ref->items, ref->size, sizeof(check_item), str_item_cmp);
+}
+
+/* Inserts key with a new value into a sorted reference, behind any equal
+   keys, as vector_insert_sorted does */
+static void ref_insert_sorted(check_ref* ref,
+                              const int key,
+                              const uintptr_t tag) {
+  size_t lo = 0, hi = ref->size;
+  while (lo < hi) {
+    size_t m = lo + (hi - lo) / 2;
+    if (key < ref->items[m].key)
+      hi = m;
+    else
+      lo = m + 1;
+  }
+  ref_reserve(ref, ref->size + 1);
+  memmove(&ref->items[lo + 1], &ref->items[lo],
+          (ref->size - lo) * sizeof(check_item));
+  ref->items[lo] = (check_item){key, tag, 0};
+  ref->size++;
+}
+
+static void ref_erase(check_ref* ref, const size_t at) {
+  memmove(&ref->items[at], &ref->items[at + 1],
+          (ref->size - at - 1) * sizeof(check_item));
+  ref->size--;
+}
+
+/* Key prefixes: the whole key, coarse groups, one for all keys, and one
+   that is UINT64_MAX for the upper keys */
+static uint64_t exact_prefix(const void* key) {
+  return (uint64_t)*(const int*)key;
+}
+
+static uint64_t coarse_prefix(const void* key) {
+  return (uint64_t)(*(const int*)key >> 4);
+}
+
+static uint64_t flat_prefix(const void* key) {
+  (void)key; /* unused */
+  return 0;
+}
+
+static uint64_t top_prefix(const void* key) {
+  int k = *(const int*)key;
+  return k >= CHECK_KEYS / 16 ? UINT64_MAX : (uint64_t)k;
+}
+
+static const vec_key_prefix_func prefix_funcs[] = {
+    exact_prefix, coarse_prefix, flat_prefix, top_prefix};
+
+/* Inline prefixes from a random one of the functions above, or none */
+static void random_inline_prefix(vector* vec) {
+  size_t f = rng_below(6);
+  vec_key_prefix_func func = f < 4 ? prefix_funcs[f] : NULL;
+  vector_set_inline_prefix(vec, func, func == exact_prefix);
+}
+
+/* ---------- Structure ---------- */
+
+/* Elements, in order and with their values, against the reference, the
+   sorted prefix the vector claims, and that every inline prefix moved
+   with its element */
+static void check_vector(const vector* vec,
+                         const check_ref* ref,
+                         const char* pass,
+                         const size_t op) {
+  if (vector_size(vec) != ref->size)
+    fail(pass, "size differs from the reference", op);
+  if (vec->size > vec->capacity)
+    fail(pass, "size above the capacity", op);
+  for (size_t i = 0; i < ref->size; i++) {
+    const vect_elem* e = &vec->data[i];
+    if (*(const int*)e->key != ref->items[i].key ||
+        *(const uintptr_t*)e->value != ref->items[i].tag)
+      fail(pass, "element differs from the reference", op);
+  }
+  if (vec->sorted && vec->sorted_prefix != vec->size)
+    fail(pass, "sorted vector with a shorter sorted prefix", op);
+  if (vec->sorted_prefix > vec->size)
+    fail(pass, "sorted prefix longer than the vector", op);
+  for (size_t i = 1; i < vec->sorted_prefix; i++)
+    if (int_cmp(vec->data[i - 1].key, vec->data[i].key) > 0)
+      fail(pass, "sorted prefix out of order", op);
+  if ((vec->prefixes != NULL) != (vec->inline_prefix != NULL))
+    fail(pass, "prefix array and prefix function disagree", op);
+  for (size_t i = 0; vec->prefixes && i < vec->size; i++)
+    if (vec->prefixes[i] != vec->inline_prefix(vec->data[i].key))
+      fail(pass, "inline prefix does not belong to its element", op);
+}
+
+/* ---------- Passes ---------- */
+
+/* Keys for a vector of n elements to be sorted: random, ascending or
+   descending runs, a handful of distinct keys, or sorted with a short
+   random tail */
+static int sort_key(const int mode, const size_t i, const size_t n) {
+  static int run_key;
+  static size_t run_left;
+  switch (mode) {
+    case 0:
+      return (int)rng_below(CHECK_KEYS);
+    case 1:
+    case 2:
+      if (run_left == 0) {
+        run_left = 1 + rng_below(200);
+        run_key = (int)rng_below(CHECK_KEYS);
+      } else {
+        /* Steps of 0 make non-strict runs, which are not reversed */
+        run_key += (mode == 1 ? 1 : -1) * (int)rng_below(3);
+        run_key = run_key < 0 ? 0 : run_key >= CHECK_KEYS ? CHECK_KEYS - 1
+                                                          : run_key;
+      }
+      run_left--;
+      return run_key;
+    case 3:
+      return (int)rng_below(4);
+    default:
+      if (i + n / 8 >= n)
+        return (int)rng_below(CHECK_KEYS);
+      return (int)(i * CHECK_KEYS / n);
+  }
+}
+
+/* vector_sort_stable on random, run-structured and duplicate heavy
+   input, then again after appended tails of various lengths (a short one
+   is merged in behind the sorted prefix). Some vectors keep inline
+   prefixes. */
+static void pass_sort(const size_t ops) {
+  const char* pass = "merge sort";
+  check_ref ref = {NULL, 0, 0};
+  size_t done = 0;
+  while (done < ops) {
+    vector* vec = make_vector(pass);
+    random_inline_prefix(vec);
+    ref.size = 0;
+    int mode = (int)rng_below(5);
+    size_t n = rng_below(4) == 0 ? rng_below(VEC_MIN_RUN * 2)
+                                 : rng_below(CHECK_MAX_SORT);
+    for (size_t i = 0; i < n; i++)
+      push(vec, &ref, sort_key(mode, i, n), pass);
+    vector_sort_stable(vec);
+    ref_sort(&ref);
+    done += n;
+    check_vector(vec, &ref, pass, done);
+    if (!vector_is_sorted(vec))
+      fail(pass, "not marked sorted", done);
+
+    for (int round = (int)rng_below(4); round > 0; round--) {
+      size_t k = rng_below(4) == 0 ? rng_below(n + 2) : rng_below(n / 8 + 2);
+      for (size_t i = 0; i < k; i++)
+        push(vec, &ref, sort_key(mode, i, k), pass);
+      vector_sort_stable(vec);
+      ref_sort(&ref);
+      done += k;
+      check_vector(vec, &ref, pass, done);
+    }
+    vector_destroy(vec);
+  }
+
+  /* Large enough for vector_sort_parallel to split it between threads */
+  vector* vec = make_vector(pass);
+  random_inline_prefix(vec);
+  ref.size = 0;
+  int mode = (int)rng_below(5);
+  size_t n = 2 * VEC_PARALLEL_MIN_CHUNK + rng_below(VEC_PARALLEL_MIN_CHUNK);
+  for (size_t i = 0; i < n; i++)
+    push(vec, &ref, sort_key(mode, i, n), pass);
+  vector_sort_parallel(vec, 2 + rng_below(3));
+  ref_sort(&ref);
+  check_vector(vec, &ref, "parallel merge sort", done + n);
+  vector_destroy(vec);
+  free(ref.items);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* What vector_binary_search (or vector_index_search) may return for key,
+   given the first prefix elements are sorted: the newest equal element of
+   the tail, else any equal element of the prefix, else nothing */
+static void check_lookup(vector* vec,
+                         const check_ref* ref,
+                         const size_t prefix,
+                         const int key,
+                         const int indexed,
+                         const char* pass,
+                         const size_t op) {
+  const uintptr_t* v = indexed ? vector_index_search(vec, &key_vals[key])
+                               : vector_binary_search(vec, &key_vals[key]);
+  for (size_t i = ref->size; i-- > prefix;) {
+    if (ref->items[i].key == key) {
+      if (!v || *v != ref->items[i].tag)
+        fail(pass, "lookup misses the newest element of the tail", op);
+      return;
+    }
+  }
+  int found = 0;
+  for (size_t i = 0; i < prefix; i++) {
+    if (ref->items[i].key != key)
+      continue;
+    if (v && *v == ref->items[i].tag)
+      return;
+    found = 1;
+  }
+  if (found || v)
+    fail(pass, "lookup differs from the reference", op);
+}
+
+/* vector_insert_sorted, vector_push_back and vector_binary_search in
+   random order, with the buffered tail on (at various lengths) and off.
+   The reference follows the vector's sorted prefix: a push leaves it
+   alone until the tail outgrows max_tail and is merged in, an insertion
+   sorts first and keeps the whole vector sorted. */
+static void pass_insert(const size_t ops) {
+  const char* pass = "sorted insert";
+  vector* vec = make_vector(pass);
+  check_ref ref = {NULL, 0, 0};
+  size_t prefix = 0; /* sorted prefix of the reference */
+  int sorted = 0;
+  size_t max_tail = 1 + rng_below(64);
+  vector_set_buffered(vec, max_tail);
+  for (size_t op = 1; op <= ops; op++) {
+    /* Half the keys from a short range, so the tail repeats keys */
+    int key = (int)rng_below(rng_below(2) ? 32 : CHECK_KEYS / 8);
+    size_t r = rng_below(100);
+    if (r < 55) {
+      push(vec, &ref, key, pass);
+      sorted = 0;
+      if (max_tail && ref.size - prefix > max_tail) {
+        ref_sort(&ref);
+        prefix = ref.size;
+        sorted = 1;
+      }
+    } else if (r < 65) {
+      if (!sorted)
+        ref_sort(&ref);
+      uintptr_t* v = make_value();
+      ref_insert_sorted(&ref, key, *v);
+      if (vector_insert_sorted(vec, &key_vals[key], v) != 0)
+        fail(pass, "vector_insert_sorted failed", op);
+      prefix = ref.size;
+      sorted = 1;
+    } else if (r < 97) {
+      if (sorted || max_tail)
+        check_lookup(vec, &ref, prefix, key, 0, pass, op);
+      else if (vector_binary_search(vec, &key_vals[key]))
+        fail(pass, "lookup in an unsorted vector", op);
+    } else if (r < 99) {
+      max_tail = rng_below(3) == 0 ? 0 : 1 + rng_below(64);
+      vector_set_buffered(vec, max_tail);
+    } else {
+      vector_sort_stable(vec);
+      ref_sort(&ref);
+      prefix = ref.size;
+      sorted = 1;
+    }
+
+    if (vector_is_sorted(vec) != sorted || vec->sorted_prefix != prefix)
+      fail(pass, "sorted state differs from the reference", op);
+    if (op % CHECK_EVERY == 0)
+      check_vector(vec, &ref, pass, op);
+    if (ref.size > CHECK_MAX_SORT) {
+      vector_clear(vec);
+      ref.size = 0;
+      prefix = 0;
+      sorted = 0;
+    }
+  }
+  check_vector(vec, &ref, pass, ops);
+  vector_destroy(vec);
+  free(ref.items);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* vector_index_search between changes of every kind, each of which must
+   invalidate the index: sorted insertions, pushes into the buffered tail,
+   deletions, unsorted insertions and re-sorts. The index prefix function
+   changes now and then, to one with ties, all ties or UINT64_MAX. With
+   inline_prefix set the vector keeps inline prefixes, from a function
+   that changes the same way, sorts by radix too, and the index sometimes
+   shares the inline function. */
+static void pass_index(const size_t ops, const int inline_prefix) {
+  const char* pass = inline_prefix ? "inline prefix" : "search index";
+  vector* vec = make_vector(pass);
+  check_ref ref = {NULL, 0, 0};
+  size_t prefix = 0;
+  int sorted = 0;
+  size_t max_tail = rng_below(2) ? 0 : 1 + rng_below(32);
+  vector_set_buffered(vec, max_tail);
+  vector_set_index(vec, exact_prefix);
+  if (inline_prefix)
+    vector_set_inline_prefix(vec, exact_prefix, 1);
+  for (size_t op = 1; op <= ops; op++) {
+    int key = (int)rng_below(CHECK_KEYS / 8);
+    size_t r = rng_below(100);
+    if (r < 50) {
+      if (sorted || max_tail)
+        check_lookup(vec, &ref, prefix, key, 1, pass, op);
+      else if (vector_index_search(vec, &key_vals[key]))
+        fail(pass, "lookup in an unsorted vector", op);
+    } else if (r < 70) {
+      if (!sorted)
+        ref_sort(&ref);
+      uintptr_t* v = make_value();
+      ref_insert_sorted(&ref, key, *v);
+      if (vector_insert_sorted(vec, &key_vals[key], v) != 0)
+        fail(pass, "vector_insert_sorted failed", op);
+      prefix = ref.size;
+      sorted = 1;
+    } else if (r < 80) {
+      push(vec, &ref, key, pass);
+      sorted = 0;
+      if (max_tail && ref.size - prefix > max_tail) {
+        ref_sort(&ref);
+        prefix = ref.size;
+        sorted = 1;
+      }
+    } else if (r < 92) {
+      if (ref.size == 0)
+        continue;
+      size_t at = rng_below(ref.size);
+      if (vector_delete(vec, at) != 0)
+        fail(pass, "vector_delete failed", op);
+      ref_erase(&ref, at);
+      if (at < prefix)
+        prefix--;
+    } else if (r < 94) {
+      if (ref.size == 0)
+        continue;
+      size_t at = rng_below(ref.size);
+      uintptr_t* v = make_value();
+      if (vector_insert_after(vec, at, &key_vals[key], v) != 0)
+        fail(pass, "vector_insert_after failed", op);
+      ref_reserve(&ref, ref.size + 1);
+      memmove(&ref.items[at + 2], &ref.items[at + 1],
+              (ref.size - at - 1) * sizeof(check_item));
+      ref.items[at + 1] = (check_item){key, *v, 0};
+      ref.size++;
+      sorted = 0;
+      if (prefix > at + 1)
+        prefix = at + 1;
+    } else if (r < 98) {
+      if (vec->prefixes && rng_below(2)) {
+        if (vector_sort_radix(vec, VEC_RADIX_PREFIX) != 0)
+          fail(pass, "vector_sort_radix failed", op);
+      } else {
+        vector_sort_stable(vec);
+      }
+      ref_sort(&ref);
+      prefix = ref.size;
+      sorted = 1;
+    } else if (inline_prefix && rng_below(2)) {
+      random_inline_prefix(vec);
+      if (rng_below(2))
+        vector_set_index(vec, vec->inline_prefix);
+    } else {
+      size_t f = rng_below(5);
+      vector_set_index(vec, f < 4 ? prefix_funcs[f] : NULL);
+    }
+
+    if (vector_is_sorted(vec) != sorted || vec->sorted_prefix != prefix)
+      fail(pass, "sorted state differs from the reference", op);
+    if (op % CHECK_EVERY == 0)
+      check_vector(vec, &ref, pass, op);
+    if (ref.size > CHECK_MAX_SORT) {
+      vector_clear(vec);
+      ref.size = 0;
+      prefix = 0;
+      sorted = 0;
+    }
+  }
+  check_vector(vec, &ref, pass, ops);
+  vector_destroy(vec);
+  free(ref.items);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* Elements of a vector of string keys against the reference */
+static void check_strings(const vector* vec,
+                          const check_ref* ref,
+                          const char* pass,
+                          const size_t op) {
+  if (vector_size(vec) != ref->size)
+    fail(pass, "size differs from the reference", op);
+  for (size_t i = 0; i < ref->size; i++) {
+    const vect_elem* e = &vec->data[i];
+    if (e->key != str_keys[ref->items[i].key] ||
+        *(const uintptr_t*)e->value != ref->items[i].tag)
+      fail(pass, "element differs from the reference", op);
+  }
+}
+
+/* First eight bytes, big endian and zero padded, ordered like strcmp */
+static uint64_t str_prefix(const void* key) {
+  const unsigned char* s = key;
+  uint64_t p = 0;
+  for (int i = 0; i < 8; i++) {
+    p <<= 8;
+    if (*s)
+      p |= *s++;
+  }
+  return p;
+}
+
+/* vector_sort_radix against the stable reference order: VEC_RADIX_STRING
+   on string keys, with and without inline prefixes, and VEC_RADIX_PREFIX
+   on int keys with exact prefixes and with ties of every size. Vectors
+   are sorted again after appends, and some are shorter than
+   VEC_RADIX_CUTOFF. */
+static void pass_radix(const size_t ops) {
+  const char* pass = "radix sort";
+  check_ref ref = {NULL, 0, 0};
+  size_t done = 0;
+  while (done < ops) {
+    int strings = (int)rng_below(2);
+    vector* vec = vector_create(1 + rng_below(16),
+                                strings ? str_cmp : int_cmp, free_elem);
+    if (!vec)
+      fail(pass, "vector_create failed", done);
+    if (strings) {
+      if (rng_below(2))
+        vector_set_inline_prefix(vec, str_prefix, 0);
+    } else {
+      if (vector_sort_radix(vec, VEC_RADIX_PREFIX) == 0)
+        fail(pass, "prefix sort without inline prefixes", done);
+      random_inline_prefix(vec);
+      if (!vec->prefixes)
+        vector_set_inline_prefix(vec, exact_prefix, 1);
+    }
+    vec_radix_kind kind = strings ? VEC_RADIX_STRING : VEC_RADIX_PREFIX;
+    ref.size = 0;
+    size_t n = rng_below(4) == 0 ? rng_below(VEC_RADIX_CUTOFF * 2)
+                                 : rng_below(CHECK_MAX_SORT);
+    for (int round = 0; round < 3; round++) {
+      for (size_t i = 0; i < n; i++) {
+        int key = (int)rng_below(rng_below(4) ? CHECK_KEYS : 8);
+        if (strings) {
+          uintptr_t* v = make_value();
+          if (vector_push_back(vec, str_keys[key], v) != 0)
+            fail(pass, "vector_push_back failed", done);
+          ref_reserve(&ref, ref.size + 1);
+          ref.items[ref.size++] = (check_item){key, *v, 0};
+        } else {
+          push(vec, &ref, key, pass);
+        }
+      }
+      if (vector_sort_radix(vec, kind) != 0)
+        fail(pass, "vector_sort_radix failed", done);
+      done += ref.size;
+      if (strings) {
+        ref_sort_strings(&ref);
+        check_strings(vec, &ref, pass, done);
+      } else {
+        ref_sort(&ref);
+        check_vector(vec, &ref, pass, done);
+      }
+      if (!vector_is_sorted(vec))
+        fail(pass, "not marked sorted", done);
+      n = rng_below(n / 4 + 2);
+    }
+    vector_destroy(vec);
+  }
+  free(ref.items);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+/* vector_delete_if predicate: keys in one residue class */
+typedef struct check_residue {
+  int mod;
+  int rem;
+} check_residue;
+
+static int in_residue(void* key, void* value, void* user_data) {
+  const check_residue* r = user_data;
+  (void)value; /* unused */
+  return *(int*)key % r->mod == r->rem;
+}
+
+/* Batch deletion and shrinking between pushes and sorted insertions:
+   vector_delete_range (out of bounds ranges included), vector_delete_if
+   and vector_shrink_to_fit, with auto shrink and inline prefixes turned
+   on and off. Each deleted value must be freed exactly once, the kept
+   ones keep their order and the sorted prefix shrinks to what is left
+   of it. */
+static void pass_delete(const size_t ops) {
+  const char* pass = "batch delete";
+  vector* vec = make_vector(pass);
+  check_ref ref = {NULL, 0, 0};
+  size_t prefix = 0;
+  int sorted = 0;
+  int auto_shrink = 0;
+  for (size_t op = 1; op <= ops; op++) {
+    int key = (int)rng_below(CHECK_KEYS / 8);
+    size_t r = rng_below(100);
+    int deleted = 0;
+    if (r < 40) {
+      push(vec, &ref, key, pass);
+      sorted = 0;
+    } else if (r < 60) {
+      if (!sorted)
+        ref_sort(&ref);
+      uintptr_t* v = make_value();
+      ref_insert_sorted(&ref, key, *v);
+      if (vector_insert_sorted(vec, &key_vals[key], v) != 0)
+        fail(pass, "vector_insert_sorted failed", op);
+      prefix = ref.size;
+      sorted = 1;
+    } else if (r < 80) {
+      size_t from = rng_below(ref.size + 2);
+      size_t to = from + rng_below(rng_below(4) ? 8 : ref.size + 2);
+      int valid = to <= ref.size;
+      if (rng_below(16) == 0) {
+        size_t swap = from; /* from > to, or an empty range */
+        from = to;
+        to = swap;
+        valid = from == to && to <= ref.size;
+      }
+      if ((vector_delete_range(vec, from, to) == 0) != valid)
+        fail(pass, "vector_delete_range accepted a bad range", op);
+      if (valid) {
+        memmove(&ref.items[from], &ref.items[to],
+                (ref.size - to) * sizeof(check_item));
+        ref.size -= to - from;
+        if (from < prefix)
+          prefix -= (to < prefix ? to : prefix) - from;
+        deleted = 1;
+      }
+    } else if (r < 90) {
+      check_residue res = {1 + (int)rng_below(8), 0};
+      res.rem = (int)rng_below((size_t)res.mod);
+      size_t kept = 0, kept_prefix = 0;
+      for (size_t i = 0; i < ref.size; i++) {
+        if (ref.items[i].key % res.mod == res.rem)
+          continue;
+        kept_prefix += i < prefix;
+        ref.items[kept++] = ref.items[i];
+      }
+      if (vector_delete_if(vec, in_residue, &res) != ref.size - kept)
+        fail(pass, "vector_delete_if miscounted", op);
+      deleted = kept < ref.size; /* deleting nothing does not shrink */
+      ref.size = kept;
+      prefix = kept_prefix;
+    } else if (r < 95) {
+      if (vector_shrink_to_fit(vec) != 0)
+        fail(pass, "vector_shrink_to_fit failed", op);
+      if (vec->capacity != (ref.size ? ref.size : 1))
+        fail(pass, "shrink to fit left spare capacity", op);
+    } else if (r < 98) {
+      auto_shrink = !auto_shrink;
+      vector_set_auto_shrink(vec, auto_shrink);
+    } else {
+      random_inline_prefix(vec);
+    }
+
+    if (deleted && auto_shrink &&
+        ref.size < vec->capacity / VEC_SHRINK_RATIO &&
+        vec->capacity != (ref.size ? ref.size : 1))
+      fail(pass, "auto shrink kept the capacity", op);
+    if (live_data != (long)ref.size)
+      fail(pass, "values freed not exactly once", op);
+    if (vector_is_sorted(vec) != sorted || vec->sorted_prefix != prefix)
+      fail(pass, "sorted state differs from the reference", op);
+    if (op % CHECK_EVERY == 0)
+      check_vector(vec, &ref, pass, op);
+    if (ref.size > CHECK_MAX_SORT) {
+      vector_clear(vec);
+      ref.size = 0;
+      prefix = 0;
+      sorted = 0;
+    }
+  }
+  check_vector(vec, &ref, pass, ops);
+  vector_destroy(vec);
+  free(ref.items);
+  printf("%-28s %10zu ops ok\n", pass, ops);
+}
+
+int main(int argc, char** argv) {
+  size_t ops = argc > 1 ? strtoul(argv[1], NULL, 10) : CHECK_DEFAULT_OPS;
+  if (ops == 0)
+    ops = CHECK_DEFAULT_OPS;
+  rng_state = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+  for (int k = 0; k < CHECK_KEYS; k++)
+    key_vals[k] = k;
+  make_str_keys();
+
+  pass_sort(ops);
+  pass_insert(ops);
+  pass_index(ops, 0);
+  pass_index(ops, 1);
+  pass_radix(ops);
+  pass_delete(ops);
+  if (live_data != 0) {
+    fprintf(stderr, "%ld values not freed\n", live_data);
+    abort();
+  }
+  return 0;
+}
@@ -1,39 +1,26 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "dict.h"
 #include "vector.h"
 
-typedef struct {
-  char* trad;
-  char* simp;
-  char* pinyin;
-  char* translation;
-} ChineseDictEntry;
-
-char* xstrdup(const char* s);
 int int_cmp(const void* a, const void* b);
 int str_cmp(const void* a, const void* b);
+uint64_t int_prefix(const void* key);
 void free_pair(void* key, void* value);
 char* make_str(const char* s);
 void print_vector(const vector* vec, const char* label);
 void print_cb(size_t idx, void* k, void* v, void* ud);
 void print_chin(size_t index, void* key, void* data, void* user_data);
-void free_chin(void* key, void* data);
 void example1(void);
 void example2(void);
+void example3(void);
 int main(void);
 
 /* ---------- Helpers ---------- */
 
-char* xstrdup(const char* s) {
-  size_t len = strlen(s) + 1;
-  char* p = malloc(len);
-  if (p)
-    memcpy(p, s, len);
-  return p;
-}
-
 int int_cmp(const void* a, const void* b) {
   int ia = *(const int*)a;
   int ib = *(const int*)b;
@@ -41,11 +28,19 @@ int int_cmp(const void* a, const void* b) {
 }
 
 int str_cmp(const void* a, const void* b) {
+  /* Interned keys are equal exactly when their pointers are */
+  if (a == b)
+    return 0;
   const char* sa = a;
   const char* sb = b;
   return strcmp(sa, sb);
 }
 
+/* The whole int as an unsigned prefix in the same order */
+uint64_t int_prefix(const void* key) {
+  return (uint64_t)((uint32_t)*(const int*)key ^ 0x80000000u);
+}
+
 void free_pair(void* key, void* value) {
   free(key);
   free(value);
@@ -84,16 +79,6 @@ void print_chin(size_t index, void* key, void* data, void* user_data) {
          c->simp, c->pinyin, c->translation);
 }
 
-void free_chin(void* key, void* data) {
-  free(key);
-  ChineseDictEntry* d = data;
-  free(d->trad);
-  free(d->simp);
-  free(d->pinyin);
-  free(d->translation);
-  free(d);
-}
-
 /* ---------- Tests ---------- */
 
 void example1(void) {
@@ -242,55 +227,26 @@ void example1(void) {
 void example2(void) {
   puts("Example 2\n-------");
 
-  vector* chin = vector_create(10, str_cmp, free_chin);
+  vector* chin = vector_create(10, str_cmp, NULL);
   if (!chin) {
     fprintf(stderr, "Failed to create\n");
     abort();
   }
 
-  FILE* fp = fopen("data/handedict.txt", "r");
-  char* line = NULL;
-  size_t len = 0;
-
-  if (fp == NULL) {
-    perror("Failed to open file");
+  /* Keys and entries point into the loaded file, parsed on all CPUs */
+  dict_file* dict = dict_load_parallel("data/handedict.txt", 0);
+  if (!dict) {
+    perror("Failed to load file");
     abort();
   }
-
-  while (getline(&line, &len, fp) != -1) {
-    line[strcspn(line, "\n")] = '\0';
-
-    char* field = line;
-    char* tab;
-    ChineseDictEntry* d = malloc(sizeof(ChineseDictEntry));
-
-    d->trad = NULL;
-    d->simp = NULL;
-    d->pinyin = NULL;
-    d->translation = NULL;
-    int index = 0;
-
-    while ((tab = strchr(field, '\t'))) {
-      *tab = '\0';
-      index++;
-      switch (index) {
-        case 1:
-          d->trad = xstrdup(field);
-          break;
-        case 2:
-          d->simp = xstrdup(field);
-          break;
-        case 3:
-          d->pinyin = xstrdup(field);
-          break;
-      }
-      field = tab + 1;
-    }
-    d->translation = xstrdup(field);
-    vector_push_back(chin, xstrdup(d->trad), d);
+  /* Repeated keys, and simplified forms equal to them, share one pointer */
+  intern_pool* pool = intern_create(dict->count);
+  if (!pool || dict_intern(dict, pool) != 0) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
   }
-  free(line);
-  fclose(fp);
+  for (size_t i = 0; i < dict->count; i++)
+    vector_push_back(chin, dict->entries[i].trad, &dict->entries[i]);
 
   printf("-------\nSize: %ld\n", vector_size(chin));
   printf("-------\nIs Sorted?: %d\n", vector_is_sorted(chin));
@@ -373,11 +329,51 @@ void example2(void) {
   printf("-------\nIs Sorted?: %d\n", vector_is_sorted(chin));
   puts("-------");
 
+#ifdef CONTAINER_STATS
+  vec_statistics st = vector_stats(chin);
+  printf("Sorts: %zu, comparisons: %zu, bytes moved: %zu\n-------\n", st.sorts,
+         st.sort_cmps, st.bytes_moved);
+#endif
+
   vector_destroy(chin);
+  intern_destroy(pool);
+  dict_free(dict);
+}
+
+void example3(void) {
+  puts("\nExample 3\n-------");
+
+  vector* vec = vector_create(4, int_cmp, free_pair);
+  if (!vec) {
+    fprintf(stderr, "Failed to create vector\n");
+    return;
+  }
+
+  /* Keys are stored inline, sorting and searching never read them */
+  vector_set_inline_prefix(vec, int_prefix, 1);
+  int keys[] = {42, -7, 13, 0, 42, -100, 7};
+  char buf[32];
+  for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+    snprintf(buf, sizeof(buf), "value-%zu", i);
+    vector_push_back(vec, make_int(keys[i]), make_str(buf));
+  }
+
+  printf("Sorted with inline keys:\n");
+  vector_iterate_sorted(vec, print_cb, 0, NULL);
+
+  int key = 42;
+  printf("\nBinary search key=42 -> %s\n",
+         (char*)vector_binary_search(vec, &key));
+  key = -7;
+  printf("Binary search key=-7 -> %s\n",
+         (char*)vector_binary_search(vec, &key));
+
+  vector_destroy(vec);
 }
 
 int main(void) {
   example1();
   example2();
+  example3();
   return 0;
 }
\ No newline at end of file
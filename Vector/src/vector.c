@@ -1,10 +1,111 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "vector.h"
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #define VEC_GROWTH_FACTOR 2
 
+/* ---------- Statistics ---------- */
+
+/* Comparisons and moves made inside sorts. Built with CONTAINER_STATS,
+   they are counted per thread, so parallel sort tasks need no atomics,
+   and each sort adds what its threads counted to the vector. Otherwise
+   all of this compiles to nothing. */
+typedef struct {
+  size_t cmps;
+  size_t moved;
+} vec_sort_count;
+
+#ifdef CONTAINER_STATS
+static _Thread_local vec_sort_count vec_tls_count;
+#define VEC_COUNT_CMP() (vec_tls_count.cmps++)
+#define VEC_COUNT_MOVE(bytes) (vec_tls_count.moved += (bytes))
+#define VEC_STAT_ADD(vec, field, n) ((vec)->stats.field += (n))
+#else
+#define VEC_COUNT_CMP() ((void)0)
+#define VEC_COUNT_MOVE(bytes) ((void)(bytes))
+#define VEC_STAT_ADD(vec, field, n) ((void)(vec))
+#endif
+
+/* What the calling thread has counted so far */
+static inline vec_sort_count vec_count_mark(void) {
+#ifdef CONTAINER_STATS
+  return vec_tls_count;
+#else
+  return (vec_sort_count){0, 0};
+#endif
+}
+
+/* Adds what the calling thread counted since mark to out */
+static inline void vec_count_since(const vec_sort_count mark,
+                                   vec_sort_count* out) {
+#ifdef CONTAINER_STATS
+  out->cmps += vec_tls_count.cmps - mark.cmps;
+  out->moved += vec_tls_count.moved - mark.moved;
+#else
+  (void)mark; /* unused */
+  (void)out;  /* unused */
+#endif
+}
+
+/* Adds one sort and its counts to the vector */
+static inline void vec_stat_sort(vector* vec, const vec_sort_count c) {
+  VEC_STAT_ADD(vec, sorts, 1);
+  VEC_STAT_ADD(vec, sort_cmps, c.cmps);
+  VEC_STAT_ADD(vec, bytes_moved, c.moved);
+  (void)c; /* unused without statistics */
+}
+
+/* Bytes an element takes, its inline prefix included if kept */
+static inline size_t elem_bytes(const uint64_t* prefixes) {
+  return sizeof(vect_elem) + (prefixes ? sizeof(uint64_t) : 0);
+}
+
+/* memmove of n elements, and their inline prefixes, from position src to
+   dst by an insertion or deletion */
+static inline void vec_move(vector* vec,
+                            const size_t dst,
+                            const size_t src,
+                            const size_t n) {
+  VEC_STAT_ADD(vec, bytes_moved, n * elem_bytes(vec->prefixes));
+  memmove(&vec->data[dst], &vec->data[src], n * sizeof(vect_elem));
+  if (vec->prefixes)
+    memmove(&vec->prefixes[dst], &vec->prefixes[src], n * sizeof(uint64_t));
+}
+
+/* memmove of n elements, and their prefixes if pa is set, from position
+   src to dst of a inside a sort */
+static inline void sort_move(vect_elem* a,
+                             uint64_t* pa,
+                             const size_t dst,
+                             const size_t src,
+                             const size_t n) {
+  VEC_COUNT_MOVE(n * elem_bytes(pa));
+  memmove(&a[dst], &a[src], n * sizeof(vect_elem));
+  if (pa)
+    memmove(&pa[dst], &pa[src], n * sizeof(uint64_t));
+}
+
+/* memcpy of n elements, and their prefixes if pdst is set */
+static inline void sort_copy(vect_elem* dst,
+                             uint64_t* pdst,
+                             const vect_elem* src,
+                             const uint64_t* psrc,
+                             const size_t n) {
+  memcpy(dst, src, n * sizeof(vect_elem));
+  if (pdst)
+    memcpy(pdst, psrc, n * sizeof(uint64_t));
+}
+
+/* Prefixes from position i on, NULL if there are none */
+static inline uint64_t* prefix_at(uint64_t* prefixes, const size_t i) {
+  return prefixes ? prefixes + i : NULL;
+}
+
 /* ---------- Internal ---------- */
 
 static int vector_resize(vector* vec, size_t new_cap) {
@@ -12,10 +113,61 @@ static int vector_resize(vector* vec, size_t new_cap) {
   if (!p)
     return -1;
   vec->data = p;
+  if (vec->prefixes) {
+    uint64_t* q = realloc(vec->prefixes, new_cap * sizeof(uint64_t));
+    if (!q)
+      return -1;
+    vec->prefixes = q;
+  }
   vec->capacity = new_cap;
   return 0;
 }
 
+/* Auto shrink after a deletion, see vector_set_auto_shrink */
+static void vector_maybe_shrink(vector* vec) {
+  if (vec->auto_shrink && vec->size < vec->capacity / VEC_SHRINK_RATIO)
+    vector_shrink_to_fit(vec);
+}
+
+/* Inline prefix of key, 0 when the vector keeps none */
+static uint64_t key_prefix(const vector* vec, const void* key) {
+  return vec->inline_prefix ? vec->inline_prefix(key) : 0;
+}
+
+/* Compares a[i] with b[j]. A sort with inline prefixes passes them in pa
+   and pb (NULL otherwise) and they decide first, the keys are only
+   compared when the prefixes are equal (and not exact). */
+static inline int elem_cmp(const vector* vec,
+                           const vect_elem* a,
+                           const uint64_t* pa,
+                           const size_t i,
+                           const vect_elem* b,
+                           const uint64_t* pb,
+                           const size_t j) {
+  VEC_COUNT_CMP();
+  if (pa) {
+    if (pa[i] != pb[j])
+      return pa[i] < pb[j] ? -1 : 1;
+    if (vec->prefix_exact)
+      return 0;
+  }
+  return vec->cmp_func(a[i].key, b[j].key);
+}
+
+/* Compares key, whose inline prefix is p, with data[i] */
+static inline int key_cmp(const vector* vec,
+                          const void* key,
+                          const uint64_t p,
+                          const size_t i) {
+  if (vec->prefixes) {
+    if (p != vec->prefixes[i])
+      return p < vec->prefixes[i] ? -1 : 1;
+    if (vec->prefix_exact)
+      return 0;
+  }
+  return vec->cmp_func(key, vec->data[i].key);
+}
+
 /* ---------- Lifecycle ---------- */
 
 vector* vector_create(const size_t initial_capacity,
@@ -37,8 +189,28 @@ vector* vector_create(const size_t initial_capacity,
   vec->size = 0;
   vec->capacity = initial_capacity;
   vec->sorted = 0;
+  vec->sorted_prefix = 0;
+  vec->max_tail = 0;
+  vec->auto_shrink = 0;
   vec->cmp_func = cmp_func;
   vec->free_func = free_func;
+  vec->inline_prefix = NULL;
+  vec->prefixes = NULL;
+  vec->prefix_exact = 0;
+  vec->scratch = NULL;
+  vec->scratch_prefixes = NULL;
+  vec->scratch_cap = 0;
+  vec->runs = NULL;
+  vec->runs_cap = 0;
+  vec->index_prefix = NULL;
+  vec->index_keys = NULL;
+  vec->index_pos = NULL;
+  vec->index_n = 0;
+  vec->index_cap = 0;
+  vec->index_valid = 0;
+#ifdef CONTAINER_STATS
+  memset(&vec->stats, 0, sizeof(vec->stats));
+#endif
 
   return vec;
 }
@@ -54,6 +226,8 @@ void vector_clear(vector* vec) {
 
   vec->size = 0;
   vec->sorted = 0;
+  vec->sorted_prefix = 0;
+  vec->index_valid = 0;
 }
 
 void vector_destroy(vector* vec) {
@@ -61,6 +235,12 @@ void vector_destroy(vector* vec) {
     return;
   vector_clear(vec);
   free(vec->data);
+  free(vec->prefixes);
+  free(vec->scratch);
+  free(vec->scratch_prefixes);
+  free(vec->runs);
+  free(vec->index_keys);
+  free(vec->index_pos);
   free(vec);
 }
 
@@ -71,11 +251,88 @@ int vector_push_back(vector* vec, void* key, void* value) {
     if (vector_resize(vec, vec->capacity * VEC_GROWTH_FACTOR) != 0)
       return -1;
   }
+  if (vec->prefixes)
+    vec->prefixes[vec->size] = vec->inline_prefix(key);
   vec->data[vec->size++] = (vect_elem){key, value};
   vec->sorted = 0;
+  /* Buffered mode merges the tail once it outgrows its limit */
+  if (vec->max_tail && vec->size - vec->sorted_prefix > vec->max_tail)
+    vector_sort_stable(vec);
   return 0;
 }
 
+/* Inserts behind any equal keys, keeping the vector sorted (an unsorted
+   vector is sorted first). Returns 0 on success, -1 on failure. */
+int vector_insert_sorted(vector* vec, void* key, void* value) {
+  if (!vec)
+    return -1;
+  if (!vec->sorted) {
+    vector_sort_stable(vec);
+    if (!vec->sorted)
+      return -1;
+  }
+  if (vec->size == vec->capacity) {
+    if (vector_resize(vec, vec->capacity * VEC_GROWTH_FACTOR) != 0)
+      return -1;
+  }
+  uint64_t p = key_prefix(vec, key);
+  size_t lo = 0, hi = vec->size;
+  while (lo < hi) {
+    size_t m = lo + (hi - lo) / 2;
+    if (key_cmp(vec, key, p, m) < 0)
+      hi = m;
+    else
+      lo = m + 1;
+  }
+  vec_move(vec, lo + 1, lo, vec->size - lo);
+  vec->data[lo] = (vect_elem){key, value};
+  if (vec->prefixes)
+    vec->prefixes[lo] = p;
+  vec->size++;
+  vec->sorted_prefix = vec->size;
+  vec->index_valid = 0;
+  return 0;
+}
+
+/* Buffered mode: vector_push_back appends to an unsorted tail of at most
+   max_tail elements behind the sorted prefix and merges it in when it
+   grows longer, and vector_binary_search also scans the tail, so lookups
+   work without a full sort after every write. 0 turns it off. */
+void vector_set_buffered(vector* vec, const size_t max_tail) {
+  if (vec)
+    vec->max_tail = max_tail;
+}
+
+/* Inline prefix mode: every element keeps prefix_func(key) in an array
+   parallel to data, and sorting and searching compare those first, so
+   only elements with equal prefixes have their keys read. With exact set
+   the prefix is the whole key (e.g. integer keys) and keys are never
+   read. Existing elements get their prefixes here; NULL turns the mode
+   off and frees the array. The mode stays off if the array cannot be
+   allocated. */
+void vector_set_inline_prefix(vector* vec,
+                              vec_key_prefix_func prefix_func,
+                              const int exact) {
+  if (!vec)
+    return;
+  vec->index_valid = 0;
+  if (prefix_func && !vec->prefixes)
+    vec->prefixes = malloc(vec->capacity * sizeof(uint64_t));
+  if (!prefix_func || !vec->prefixes) {
+    free(vec->prefixes);
+    free(vec->scratch_prefixes);
+    vec->prefixes = NULL;
+    vec->scratch_prefixes = NULL;
+    vec->inline_prefix = NULL;
+    vec->prefix_exact = 0;
+    return;
+  }
+  vec->inline_prefix = prefix_func;
+  vec->prefix_exact = exact;
+  for (size_t i = 0; i < vec->size; i++)
+    vec->prefixes[i] = prefix_func(vec->data[i].key);
+}
+
 int vector_insert_after(vector* vec,
                         const size_t index,
                         void* key,
@@ -88,12 +345,16 @@ int vector_insert_after(vector* vec,
       return -1;
   }
 
-  memmove(&vec->data[index + 2], &vec->data[index + 1],
-          (vec->size - index - 1) * sizeof(vect_elem));
+  vec_move(vec, index + 2, index + 1, vec->size - index - 1);
 
   vec->data[index + 1] = (vect_elem){key, value};
+  if (vec->prefixes)
+    vec->prefixes[index + 1] = vec->inline_prefix(key);
   vec->size++;
   vec->sorted = 0;
+  if (vec->sorted_prefix > index + 1)
+    vec->sorted_prefix = index + 1;
+  vec->index_valid = 0;
   return 0;
 }
 
@@ -104,13 +365,107 @@ int vector_delete(vector* vec, const size_t index) {
   if (vec->free_func)
     vec->free_func(vec->data[index].key, vec->data[index].value);
 
-  memmove(&vec->data[index], &vec->data[index + 1],
-          (vec->size - index - 1) * sizeof(vect_elem));
+  vec_move(vec, index, index + 1, vec->size - index - 1);
 
+  if (index < vec->sorted_prefix)
+    vec->sorted_prefix--;
   vec->size--;
+  vec->index_valid = 0;
+  vector_maybe_shrink(vec);
   return 0;
 }
 
+/* Deletes the elements [from, to) with one move of the rest. Returns 0
+   on success, -1 if the range is out of bounds. */
+int vector_delete_range(vector* vec, const size_t from, const size_t to) {
+  if (!vec || from > to || to > vec->size)
+    return -1;
+
+  if (vec->free_func) {
+    for (size_t i = from; i < to; i++)
+      vec->free_func(vec->data[i].key, vec->data[i].value);
+  }
+
+  vec_move(vec, from, to, vec->size - to);
+
+  if (from < vec->sorted_prefix) {
+    size_t end = to < vec->sorted_prefix ? to : vec->sorted_prefix;
+    vec->sorted_prefix -= end - from;
+  }
+  vec->size -= to - from;
+  vec->index_valid = 0;
+  vector_maybe_shrink(vec);
+  return 0;
+}
+
+/* Deletes every element pred accepts and compacts the rest in one pass,
+   keeping their order. Returns the number of deleted elements. */
+size_t vector_delete_if(vector* vec, vec_pred_func pred, void* user_data) {
+  if (!vec || !pred)
+    return 0;
+
+  size_t kept = 0;
+  size_t kept_prefix = 0;
+  for (size_t i = 0; i < vec->size; i++) {
+    vect_elem* e = &vec->data[i];
+    if (pred(e->key, e->value, user_data)) {
+      if (vec->free_func)
+        vec->free_func(e->key, e->value);
+      continue;
+    }
+    if (i < vec->sorted_prefix)
+      kept_prefix++;
+    if (vec->prefixes)
+      vec->prefixes[kept] = vec->prefixes[i];
+    vec->data[kept++] = *e;
+  }
+
+  size_t deleted = vec->size - kept;
+  vec->size = kept;
+  vec->sorted_prefix = kept_prefix;
+  if (deleted) {
+    vec->index_valid = 0;
+    vector_maybe_shrink(vec);
+  }
+  return deleted;
+}
+
+/* Shrinks the capacity to the size (at least one element) and releases
+   the sort buffers and the search index, which are rebuilt when needed.
+   Returns 0 on success, -1 if the array could not be reallocated. */
+int vector_shrink_to_fit(vector* vec) {
+  if (!vec)
+    return -1;
+
+  free(vec->scratch);
+  free(vec->scratch_prefixes);
+  free(vec->runs);
+  free(vec->index_keys);
+  free(vec->index_pos);
+  vec->scratch = NULL;
+  vec->scratch_prefixes = NULL;
+  vec->scratch_cap = 0;
+  vec->runs = NULL;
+  vec->runs_cap = 0;
+  vec->index_keys = NULL;
+  vec->index_pos = NULL;
+  vec->index_cap = 0;
+  vec->index_valid = 0;
+
+  size_t cap = vec->size ? vec->size : 1;
+  if (cap == vec->capacity)
+    return 0;
+  return vector_resize(vec, cap);
+}
+
+/* Auto shrink: vector_delete, vector_delete_range and vector_delete_if
+   call vector_shrink_to_fit once the size drops below a
+   VEC_SHRINK_RATIO-th of the capacity */
+void vector_set_auto_shrink(vector* vec, const int on) {
+  if (vec)
+    vec->auto_shrink = on;
+}
+
 /* ---------- Access ---------- */
 
 vect_elem* vector_get(vector* vec, const size_t index) {
@@ -121,57 +476,614 @@ vect_elem* vector_get(vector* vec, const size_t index) {
 
 /* ---------- Stable Merge Sort ---------- */
 
-static void merge(vector* vec, vect_elem* tmp, size_t l, size_t m, size_t r) {
-  size_t i = l, j = m, k = l;
+/* Makes sure the cached sort buffers hold n elements (and prefixes, with
+   inline prefixes on) and runs boundaries; their contents are not kept */
+static int vector_reserve_scratch(vector* vec, size_t n, size_t runs) {
+  if (vec->scratch_cap < n) {
+    vect_elem* p = malloc(n * sizeof(vect_elem));
+    if (!p)
+      return -1;
+    free(vec->scratch);
+    free(vec->scratch_prefixes);
+    vec->scratch = p;
+    vec->scratch_prefixes = NULL;
+    vec->scratch_cap = n;
+  }
+  if (vec->prefixes && !vec->scratch_prefixes) {
+    vec->scratch_prefixes = malloc(vec->scratch_cap * sizeof(uint64_t));
+    if (!vec->scratch_prefixes)
+      return -1;
+  }
+  if (vec->runs_cap < runs) {
+    size_t* r = malloc(runs * sizeof(size_t));
+    if (!r)
+      return -1;
+    free(vec->runs);
+    vec->runs = r;
+    vec->runs_cap = runs;
+  }
+  return 0;
+}
+
+/* Run boundaries needed by sort_range for n elements: every run but the
+   last has at least VEC_MIN_RUN elements */
+static size_t runs_needed(const size_t n) {
+  return n / VEC_MIN_RUN + 2;
+}
 
-  while (i < m && j < r) {
-    if (vec->cmp_func(tmp[i].key, tmp[j].key) <= 0)
-      vec->data[k++] = tmp[i++];
-    else
-      vec->data[k++] = tmp[j++];
+/* The sorts below take the inline prefixes of their elements alongside
+   them (pa for a, pbuf for buf, ...), NULL when the vector keeps none,
+   and move each prefix wherever its element goes */
+
+/* Stable merge of a and b into out; on ties a comes first */
+static void merge_into(const vector* vec,
+                       const vect_elem* a,
+                       const uint64_t* pa,
+                       const size_t na,
+                       const vect_elem* b,
+                       const uint64_t* pb,
+                       const size_t nb,
+                       vect_elem* out,
+                       uint64_t* pout) {
+  size_t i = 0, j = 0, k = 0;
+  while (i < na && j < nb) {
+    if (elem_cmp(vec, a, pa, i, b, pb, j) <= 0) {
+      if (pout)
+        pout[k] = pa[i];
+      out[k++] = a[i++];
+    } else {
+      if (pout)
+        pout[k] = pb[j];
+      out[k++] = b[j++];
+    }
+  }
+  memcpy(&out[k], &a[i], (na - i) * sizeof(vect_elem));
+  memcpy(&out[k + na - i], &b[j], (nb - j) * sizeof(vect_elem));
+  if (pout) {
+    memcpy(&pout[k], &pa[i], (na - i) * sizeof(uint64_t));
+    memcpy(&pout[k + na - i], &pb[j], (nb - j) * sizeof(uint64_t));
   }
+}
 
-  while (i < m)
-    vec->data[k++] = tmp[i++];
-  while (j < r)
-    vec->data[k++] = tmp[j++];
+/* Grows the sorted prefix a[0, sorted) to a[0, n) by binary insertion;
+   equal keys are inserted after the existing ones */
+static void insertion_sort(const vector* vec,
+                           vect_elem* a,
+                           uint64_t* pa,
+                           size_t sorted,
+                           const size_t n) {
+  for (; sorted < n; sorted++) {
+    vect_elem x = a[sorted];
+    uint64_t px = pa ? pa[sorted] : 0;
+    size_t lo = 0, hi = sorted;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (elem_cmp(vec, &x, pa ? &px : NULL, 0, a, pa, mid) < 0)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+    sort_move(a, pa, lo + 1, lo, sorted - lo);
+    a[lo] = x;
+    if (pa)
+      pa[lo] = px;
+  }
 }
 
-static void merge_sort(vector* vec, vect_elem* tmp, size_t l, size_t r) {
-  if (r - l < 2)
+/* Splits a into natural runs, reversing strictly descending ones and
+   extending short ones to VEC_MIN_RUN. Stores the boundaries in runs and
+   returns the number of runs. */
+static size_t find_runs(const vector* vec,
+                        vect_elem* a,
+                        uint64_t* pa,
+                        const size_t n,
+                        size_t* runs) {
+  size_t count = 0;
+  size_t i = 0;
+  runs[0] = 0;
+  while (i < n) {
+    size_t j = i + 1;
+    if (j < n && elem_cmp(vec, a, pa, j, a, pa, i) < 0) {
+      while (j < n && elem_cmp(vec, a, pa, j, a, pa, j - 1) < 0)
+        j++;
+      for (size_t l = i, r = j - 1; l < r; l++, r--) {
+        vect_elem t = a[l];
+        a[l] = a[r];
+        a[r] = t;
+        if (pa) {
+          uint64_t pt = pa[l];
+          pa[l] = pa[r];
+          pa[r] = pt;
+        }
+      }
+    } else {
+      while (j < n && elem_cmp(vec, a, pa, j, a, pa, j - 1) >= 0)
+        j++;
+    }
+    if (j - i < VEC_MIN_RUN && j < n) {
+      size_t end = n - i < VEC_MIN_RUN ? n : i + VEC_MIN_RUN;
+      insertion_sort(vec, &a[i], prefix_at(pa, i), j - i, end - i);
+      j = end;
+    }
+    runs[++count] = j;
+    i = j;
+  }
+  return count;
+}
+
+/* Merges runs [r0, r1) so the result lands in a, or in buf if to_buf is
+   set. The halves are merged into the other buffer first, so buffers
+   alternate between levels and no level copies its input; only single
+   runs that have to change buffers are copied. Going depth first keeps
+   the small merges cache resident. */
+static void merge_runs(const vector* vec,
+                       vect_elem* a,
+                       uint64_t* pa,
+                       vect_elem* buf,
+                       uint64_t* pbuf,
+                       const size_t* runs,
+                       const size_t r0,
+                       const size_t r1,
+                       const int to_buf) {
+  size_t lo = runs[r0], hi = runs[r1];
+  if (r1 - r0 == 1) {
+    if (to_buf)
+      sort_copy(&buf[lo], prefix_at(pbuf, lo), &a[lo], prefix_at(pa, lo),
+                hi - lo);
     return;
+  }
+  size_t rm = r0 + (r1 - r0) / 2;
+  size_t mid = runs[rm];
+  merge_runs(vec, a, pa, buf, pbuf, runs, r0, rm, !to_buf);
+  merge_runs(vec, a, pa, buf, pbuf, runs, rm, r1, !to_buf);
+  vect_elem* src = to_buf ? a : buf;
+  vect_elem* dst = to_buf ? buf : a;
+  uint64_t* psrc = to_buf ? pa : pbuf;
+  uint64_t* pdst = to_buf ? pbuf : pa;
+  if (elem_cmp(vec, src, psrc, mid - 1, src, psrc, mid) <= 0)
+    sort_copy(&dst[lo], prefix_at(pdst, lo), &src[lo], prefix_at(psrc, lo),
+              hi - lo);
+  else
+    merge_into(vec, &src[lo], prefix_at(psrc, lo), mid - lo, &src[mid],
+               prefix_at(psrc, mid), hi - mid, &dst[lo], prefix_at(pdst, lo));
+}
 
-  size_t m = (l + r) / 2;
-  merge_sort(vec, tmp, l, m);
-  merge_sort(vec, tmp, m, r);
+/* Stable natural merge sort of a[0, n) using buf (n elements) and runs
+   (runs_needed(n) entries). An input that is one run already costs n - 1
+   comparisons, one with a few appended elements little more. */
+static void sort_range(const vector* vec,
+                       vect_elem* a,
+                       uint64_t* pa,
+                       vect_elem* buf,
+                       uint64_t* pbuf,
+                       const size_t n,
+                       size_t* runs) {
+  size_t count = find_runs(vec, a, pa, n, runs);
+  if (count > 1)
+    merge_runs(vec, a, pa, buf, pbuf, runs, 0, count, 0);
+}
 
-  memcpy(&tmp[l], &vec->data[l], (r - l) * sizeof(vect_elem));
-  merge(vec, tmp, l, m, r);
+/* Merges the unsorted tail data[sorted_prefix, size) into the sorted
+   prefix. The tail is sorted on its own, then placed from the back, each
+   element's position found by binary search in what is left of the
+   prefix: O(k log n) comparisons for k tail elements, and each prefix
+   element moves once. */
+static void merge_tail(vector* vec) {
+  size_t p = vec->sorted_prefix;
+  size_t k = vec->size - p;
+  vect_elem* tail = vec->scratch;
+  uint64_t* ptail = vec->prefixes ? vec->scratch_prefixes : NULL;
+  sort_range(vec, &vec->data[p], prefix_at(vec->prefixes, p), tail, ptail, k,
+             vec->runs);
+  sort_copy(tail, ptail, &vec->data[p], prefix_at(vec->prefixes, p), k);
+  size_t hi = p; /* prefix elements not moved yet */
+  for (size_t j = k; j-- > 0;) {
+    size_t lo = 0, h = hi;
+    while (lo < h) {
+      size_t m = lo + (h - lo) / 2;
+      if (elem_cmp(vec, tail, ptail, j, vec->data, vec->prefixes, m) < 0)
+        h = m;
+      else
+        lo = m + 1;
+    }
+    sort_move(vec->data, vec->prefixes, lo + j + 1, lo, hi - lo);
+    vec->data[lo + j] = tail[j];
+    if (ptail)
+      vec->prefixes[lo + j] = ptail[j];
+    hi = lo;
+  }
 }
 
 void vector_sort_stable(vector* vec) {
+  if (!vec)
+    return;
+
+  if (vec->size >= 2) {
+    if (vector_reserve_scratch(vec, vec->size, runs_needed(vec->size)) != 0)
+      return;
+    vec_sort_count count = {0, 0};
+    vec_sort_count mark = vec_count_mark();
+    /* A short tail behind a sorted prefix is merged in directly */
+    if (vec->sorted_prefix >= vec->size / 2)
+      merge_tail(vec);
+    else
+      sort_range(vec, vec->data, vec->prefixes, vec->scratch,
+                 vec->prefixes ? vec->scratch_prefixes : NULL, vec->size,
+                 vec->runs);
+    vec_count_since(mark, &count);
+    vec_stat_sort(vec, count);
+  }
+  vec->sorted = 1;
+  vec->sorted_prefix = vec->size;
+  vec->index_valid = 0;
+}
+
+/* ---------- Parallel Stable Merge Sort ---------- */
+
+/* One task of a parallel sort phase: sorts chunk [l, r) in place, or
+   produces output positions [l, r) of the current merge round */
+typedef struct {
+  pthread_t thread;
+  vector* vec;
+  vect_elem* src;
+  vect_elem* dst;
+  uint64_t* psrc; /* inline prefixes of src and dst, or NULL */
+  uint64_t* pdst;
+  size_t* runs; /* run boundaries for sort_range */
+  const size_t* bounds; /* chunk boundaries, chunks + 1 entries */
+  size_t chunks;
+  size_t width; /* chunks per run in this merge round */
+  size_t l;
+  size_t r;
+  vec_sort_count count; /* statistics, over all phases */
+} sort_task;
+
+/* Co-rank: how many of the first k elements of the stable merge of a and
+   b come from a */
+static size_t co_rank(const vector* vec,
+                      const size_t k,
+                      const vect_elem* a,
+                      const uint64_t* pa,
+                      const size_t na,
+                      const vect_elem* b,
+                      const uint64_t* pb,
+                      const size_t nb) {
+  size_t lo = k > nb ? k - nb : 0;
+  size_t hi = k < na ? k : na;
+  while (lo < hi) {
+    size_t i = lo + (hi - lo) / 2;
+    if (elem_cmp(vec, a, pa, i, b, pb, k - i - 1) <= 0)
+      lo = i + 1;
+    else
+      hi = i;
+  }
+  return lo;
+}
+
+static void* sort_chunk_task(void* arg) {
+  sort_task* t = arg;
+  vector* vec = t->vec;
+  vec_sort_count mark = vec_count_mark();
+  sort_range(vec, &vec->data[t->l], prefix_at(vec->prefixes, t->l),
+             &t->dst[t->l], prefix_at(t->pdst, t->l), t->r - t->l, t->runs);
+  vec_count_since(mark, &t->count);
+  return NULL;
+}
+
+/* Writes the task's share of a merge round. Runs of width chunks are
+   merged pairwise; the task's output range may cut through several merges
+   and is located in each by co-ranks, so all tasks get equal work no
+   matter how few runs are left. */
+static void* merge_slice_task(void* arg) {
+  sort_task* t = arg;
+  const vector* vec = t->vec;
+  vec_sort_count mark = vec_count_mark();
+  for (size_t c = 0; c < t->chunks; c += 2 * t->width) {
+    size_t lo = t->bounds[c];
+    size_t mid = t->bounds[c + t->width < t->chunks ? c + t->width : t->chunks];
+    size_t hi =
+        t->bounds[c + 2 * t->width < t->chunks ? c + 2 * t->width : t->chunks];
+    size_t from = t->l > lo ? t->l : lo;
+    size_t to = t->r < hi ? t->r : hi;
+    if (from >= to)
+      continue;
+    const vect_elem* a = &t->src[lo];
+    const vect_elem* b = &t->src[mid];
+    uint64_t* pa = prefix_at(t->psrc, lo);
+    uint64_t* pb = prefix_at(t->psrc, mid);
+    size_t na = mid - lo, nb = hi - mid;
+    size_t ia = co_rank(vec, from - lo, a, pa, na, b, pb, nb);
+    size_t ja = co_rank(vec, to - lo, a, pa, na, b, pb, nb);
+    size_t ib = from - lo - ia;
+    size_t jb = to - lo - ja;
+    merge_into(vec, a + ia, prefix_at(pa, ia), ja - ia, b + ib,
+               prefix_at(pb, ib), jb - ib, &t->dst[from],
+               prefix_at(t->pdst, from));
+  }
+  vec_count_since(mark, &t->count);
+  return NULL;
+}
+
+/* Runs fn on every task, task 0 on the calling thread. A task whose thread
+   cannot be created runs on the calling thread as well. */
+static void run_tasks(void* (*fn)(void*), sort_task* tasks, const size_t n) {
+  int* started = calloc(n, sizeof(int));
+  for (size_t i = 1; i < n; i++)
+    started[i] =
+        started && pthread_create(&tasks[i].thread, NULL, fn, &tasks[i]) == 0;
+  fn(&tasks[0]);
+  for (size_t i = 1; i < n; i++) {
+    if (started && started[i])
+      pthread_join(tasks[i].thread, NULL);
+    else
+      fn(&tasks[i]);
+  }
+  free(started);
+}
+
+/* Stable sort on up to the given number of threads (0: one per online
+   CPU). Each thread sorts a chunk with the sequential merge sort, then
+   log2(threads) rounds of parallel merges ping-pong between the vector
+   and a scratch buffer. Falls back to vector_sort_stable for small
+   vectors. */
+void vector_sort_parallel(vector* vec, const size_t threads) {
   if (!vec || vec->size < 2)
     return;
+  size_t n = vec->size;
+  size_t t = threads;
+  if (t == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    t = cpus > 0 ? (size_t)cpus : 1;
+  }
+  if (t > n / VEC_PARALLEL_MIN_CHUNK)
+    t = n / VEC_PARALLEL_MIN_CHUNK;
+  if (t < 2) {
+    vector_sort_stable(vec);
+    return;
+  }
 
-  vect_elem* tmp = malloc(vec->size * sizeof(vect_elem));
-  if (!tmp)
+  /* Chunk i keeps its run boundaries at bounds[i] / VEC_MIN_RUN + 2 * i,
+     clear of the neighbouring chunks' */
+  size_t* bounds = malloc((t + 1) * sizeof(size_t));
+  sort_task* tasks = malloc(t * sizeof(sort_task));
+  if (!bounds || !tasks ||
+      vector_reserve_scratch(vec, n, runs_needed(n) + 2 * t) != 0) {
+    free(bounds);
+    free(tasks);
     return;
+  }
+  uint64_t* pscratch = vec->prefixes ? vec->scratch_prefixes : NULL;
+  for (size_t i = 0; i <= t; i++)
+    bounds[i] = n * i / t;
+  for (size_t i = 0; i < t; i++) {
+    tasks[i].vec = vec;
+    tasks[i].dst = vec->scratch;
+    tasks[i].pdst = pscratch;
+    tasks[i].runs = &vec->runs[bounds[i] / VEC_MIN_RUN + 2 * i];
+    tasks[i].bounds = bounds;
+    tasks[i].chunks = t;
+    tasks[i].l = bounds[i];
+    tasks[i].r = bounds[i + 1];
+    tasks[i].count = (vec_sort_count){0, 0};
+  }
+  run_tasks(sort_chunk_task, tasks, t);
 
-  merge_sort(vec, tmp, 0, vec->size);
-  free(tmp);
+  vect_elem* src = vec->data;
+  vect_elem* dst = vec->scratch;
+  uint64_t* psrc = vec->prefixes;
+  uint64_t* pdst = pscratch;
+  for (size_t width = 1; width < t; width *= 2) {
+    for (size_t i = 0; i < t; i++) {
+      tasks[i].src = src;
+      tasks[i].dst = dst;
+      tasks[i].psrc = psrc;
+      tasks[i].pdst = pdst;
+      tasks[i].width = width;
+    }
+    run_tasks(merge_slice_task, tasks, t);
+    vect_elem* swap = src;
+    src = dst;
+    dst = swap;
+    uint64_t* pswap = psrc;
+    psrc = pdst;
+    pdst = pswap;
+  }
+  if (src != vec->data)
+    sort_copy(vec->data, vec->prefixes, src, psrc, n);
+
+  vec_sort_count count = {0, 0};
+  for (size_t i = 0; i < t; i++) {
+    count.cmps += tasks[i].count.cmps;
+    count.moved += tasks[i].count.moved;
+  }
+  vec_stat_sort(vec, count);
+  free(bounds);
+  free(tasks);
   vec->sorted = 1;
+  vec->sorted_prefix = n;
+  vec->index_valid = 0;
 }
 
-/* ---------- Binary Search ---------- */
+/* ---------- Radix Sort ---------- */
 
-void* vector_binary_search(const vector* vec, const void* key) {
-  if (!vec || !vec->sorted)
-    return NULL;
+/* Stable LSD radix sort of a[0, n) by the inline prefixes pa,
+   VEC_RADIX_BITS per pass. All histograms are taken in one read of the
+   prefixes, and passes whose digit is the same in every element are
+   skipped. */
+static int radix_sort_prefix(vect_elem* a,
+                             uint64_t* pa,
+                             vect_elem* buf,
+                             uint64_t* pbuf,
+                             const size_t n) {
+  enum { PASSES = (64 + VEC_RADIX_BITS - 1) / VEC_RADIX_BITS };
+  const uint64_t mask = ((uint64_t)1 << VEC_RADIX_BITS) - 1;
+  size_t(*counts)[1 << VEC_RADIX_BITS] = calloc(PASSES, sizeof(*counts));
+  if (!counts)
+    return -1;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t p = pa[i];
+    for (int d = 0; d < PASSES; d++)
+      counts[d][(p >> (VEC_RADIX_BITS * d)) & mask]++;
+  }
+  vect_elem* src = a;
+  vect_elem* dst = buf;
+  uint64_t* psrc = pa;
+  uint64_t* pdst = pbuf;
+  for (int d = 0; d < PASSES; d++) {
+    int shift = VEC_RADIX_BITS * d;
+    size_t* c = counts[d];
+    if (c[(psrc[0] >> shift) & mask] == n)
+      continue;
+    size_t sum = 0;
+    for (size_t b = 0; b <= mask; b++) {
+      size_t count = c[b];
+      c[b] = sum;
+      sum += count;
+    }
+    for (size_t i = 0; i < n; i++) {
+      size_t to = c[(psrc[i] >> shift) & mask]++;
+      dst[to] = src[i];
+      pdst[to] = psrc[i];
+    }
+    vect_elem* swap = src;
+    src = dst;
+    dst = swap;
+    uint64_t* pswap = psrc;
+    psrc = pdst;
+    pdst = pswap;
+  }
+  if (src != a)
+    sort_copy(a, pa, src, psrc, n);
+  free(counts);
+  return 0;
+}
+
+/* Sorts each group of equal prefixes by key. The prefixes of a group are
+   all the same, so only the elements move. */
+static void sort_prefix_ties(const vector* vec,
+                             vect_elem* a,
+                             const uint64_t* pa,
+                             vect_elem* buf,
+                             const size_t n,
+                             size_t* runs) {
+  size_t i = 0;
+  while (i < n) {
+    size_t j = i + 1;
+    while (j < n && pa[j] == pa[i])
+      j++;
+    if (j - i > 1)
+      sort_range(vec, &a[i], NULL, &buf[i], NULL, j - i, runs);
+    i = j;
+  }
+}
 
-  size_t l = 0, r = vec->size;
+/* Stable MSD radix sort of the strings in a[0, n), which share their
+   first depth bytes. The byte at depth is read once per element into
+   bytes (n entries). Bytes all elements share are stepped over without
+   moving anything, and buckets below VEC_RADIX_CUTOFF are merge sorted.
+   Strings that end at depth are equal and keep their order. */
+static void radix_sort_strings(const vector* vec,
+                               vect_elem* a,
+                               uint64_t* pa,
+                               vect_elem* buf,
+                               uint64_t* pbuf,
+                               unsigned char* bytes,
+                               const size_t n,
+                               size_t depth,
+                               size_t* runs) {
+  size_t counts[256];
+  for (;;) {
+    if (n < VEC_RADIX_CUTOFF) {
+      sort_range(vec, a, pa, buf, pbuf, n, runs);
+      return;
+    }
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < n; i++) {
+      bytes[i] = ((const unsigned char*)a[i].key)[depth];
+      counts[bytes[i]]++;
+    }
+    if (counts[bytes[0]] < n)
+      break;
+    if (bytes[0] == 0)
+      return;
+    depth++;
+  }
+  size_t start[257];
+  start[0] = 0;
+  for (int b = 0; b < 256; b++) {
+    start[b + 1] = start[b] + counts[b];
+    counts[b] = start[b];
+  }
+  for (size_t i = 0; i < n; i++) {
+    size_t to = counts[bytes[i]]++;
+    buf[to] = a[i];
+    if (pa)
+      pbuf[to] = pa[i];
+  }
+  sort_copy(a, pa, buf, pbuf, n);
+  for (int b = 1; b < 256; b++) {
+    size_t len = start[b + 1] - start[b];
+    if (len > 1)
+      radix_sort_strings(vec, &a[start[b]], prefix_at(pa, start[b]),
+                         &buf[start[b]], prefix_at(pbuf, start[b]),
+                         &bytes[start[b]], len, depth + 1, runs);
+  }
+}
+
+/* Stable radix sort, same order as vector_sort_stable. VEC_RADIX_PREFIX
+   sorts by the inline prefixes and needs vector_set_inline_prefix; with
+   an exact prefix (integer keys) it never compares, otherwise groups of
+   equal prefixes are merge sorted. VEC_RADIX_STRING needs keys that are
+   strings ordered like strcmp. Returns 0 on success, -1 on failure. */
+int vector_sort_radix(vector* vec, const vec_radix_kind kind) {
+  if (!vec || (kind == VEC_RADIX_PREFIX && !vec->prefixes))
+    return -1;
+
+  size_t n = vec->size;
+  if (n >= 2) {
+    if (vector_reserve_scratch(vec, n, runs_needed(n)) != 0)
+      return -1;
+    uint64_t* pscratch = vec->prefixes ? vec->scratch_prefixes : NULL;
+    vec_sort_count count = {0, 0};
+    vec_sort_count mark = vec_count_mark();
+    if (n < VEC_RADIX_CUTOFF) {
+      sort_range(vec, vec->data, vec->prefixes, vec->scratch, pscratch, n,
+                 vec->runs);
+    } else if (kind == VEC_RADIX_PREFIX) {
+      if (radix_sort_prefix(vec->data, vec->prefixes, vec->scratch, pscratch,
+                            n) != 0)
+        return -1;
+      if (!vec->prefix_exact)
+        sort_prefix_ties(vec, vec->data, vec->prefixes, vec->scratch, n,
+                         vec->runs);
+    } else {
+      unsigned char* bytes = malloc(n);
+      if (!bytes)
+        return -1;
+      radix_sort_strings(vec, vec->data, vec->prefixes, vec->scratch,
+                         pscratch, bytes, n, 0, vec->runs);
+      free(bytes);
+    }
+    vec_count_since(mark, &count);
+    vec_stat_sort(vec, count);
+  }
+  vec->sorted = 1;
+  vec->sorted_prefix = n;
+  vec->index_valid = 0;
+  return 0;
+}
+
+/* ---------- Binary Search ---------- */
+
+/* Binary search of data[l, r) for key, whose inline prefix is q */
+static void* search_range(const vector* vec,
+                          const void* key,
+                          const uint64_t q,
+                          size_t l,
+                          size_t r) {
   while (l < r) {
     size_t m = (l + r) / 2;
-    int c = vec->cmp_func(key, vec->data[m].key);
+    int c = key_cmp(vec, key, q, m);
     if (c == 0)
       return vec->data[m].value;
     if (c < 0)
@@ -182,6 +1094,133 @@ void* vector_binary_search(const vector* vec, const void* key) {
   return NULL;
 }
 
+/* Position of the first indexed element whose key prefix is not less
+   than p, index_n if there is none. The descent is branchless: slot k has
+   its children at 2k and 2k + 1, so the next slot is computed from the
+   comparison, and the slots three levels down are prefetched while the
+   current one is compared. The exit slot carries one 1 bit per right
+   turn after the lower bound was passed; shifting them out gives the
+   lower bound's slot. */
+static size_t index_lower_bound(const vector* vec, const uint64_t p) {
+  const uint64_t* keys = vec->index_keys;
+  size_t n = vec->index_n;
+  size_t k = 1;
+  while (k <= n) {
+    __builtin_prefetch(keys + 8 * k);
+    k = 2 * k + (keys[k] < p);
+  }
+  k >>= __builtin_ctzll(~(unsigned long long)k) + 1;
+  return k ? vec->index_pos[k] : n;
+}
+
+/* Index lookup: key prefixes decide the search without touching the
+   keys, only elements sharing the key's prefix are compared */
+static void* index_search(const vector* vec,
+                          const void* key,
+                          const uint64_t q) {
+  uint64_t p =
+      vec->index_prefix == vec->inline_prefix ? q : vec->index_prefix(key);
+  size_t i = index_lower_bound(vec, p);
+  if (i == vec->index_n)
+    return NULL;
+  int c = key_cmp(vec, key, q, i);
+  if (c == 0)
+    return vec->data[i].value;
+  if (c < 0)
+    return NULL;
+  /* data[i] has the same prefix, search the rest of its prefix range */
+  size_t end = p == UINT64_MAX ? vec->index_n : index_lower_bound(vec, p + 1);
+  return search_range(vec, key, q, i + 1, end);
+}
+
+void* vector_binary_search(const vector* vec, const void* key) {
+  if (!vec || (!vec->sorted && !vec->max_tail))
+    return NULL;
+
+  /* Buffered mode: the unsorted tail holds the newest elements */
+  uint64_t q = key_prefix(vec, key);
+  size_t prefix = vec->sorted ? vec->size : vec->sorted_prefix;
+  for (size_t i = vec->size; i-- > prefix;) {
+    if (key_cmp(vec, key, q, i) == 0)
+      return vec->data[i].value;
+  }
+
+  if (vec->index_valid && vec->index_n == prefix)
+    return index_search(vec, key, q);
+  return search_range(vec, key, q, 0, prefix);
+}
+
+/* Fills the subtree at slot k from data[i, ...) in order, returns the
+   position after the last element placed */
+static size_t index_fill(vector* vec, size_t i, const size_t k) {
+  if (k > vec->index_n)
+    return i;
+  i = index_fill(vec, i, 2 * k);
+  /* Inline prefixes from the same function are reused, keys not read */
+  vec->index_keys[k] = vec->index_prefix == vec->inline_prefix
+                           ? vec->prefixes[i]
+                           : vec->index_prefix(vec->data[i].key);
+  vec->index_pos[k] = i;
+  return index_fill(vec, i + 1, 2 * k + 1);
+}
+
+/* Builds the index over data[0, n), sized for the whole capacity so
+   growing vectors do not reallocate it on every rebuild */
+static int vector_build_index(vector* vec, const size_t n) {
+  if (vec->index_cap < n + 1) {
+    size_t cap = vec->capacity > n ? vec->capacity + 1 : n + 1;
+    size_t bytes = cap * sizeof(uint64_t);
+    bytes = (bytes + VEC_INDEX_ALIGN - 1) / VEC_INDEX_ALIGN * VEC_INDEX_ALIGN;
+    uint64_t* keys = aligned_alloc(VEC_INDEX_ALIGN, bytes);
+    size_t* pos = malloc(cap * sizeof(size_t));
+    if (!keys || !pos) {
+      free(keys);
+      free(pos);
+      return -1;
+    }
+    free(vec->index_keys);
+    free(vec->index_pos);
+    vec->index_keys = keys;
+    vec->index_pos = pos;
+    vec->index_cap = cap;
+  }
+  vec->index_n = n;
+  index_fill(vec, 0, 1);
+  vec->index_valid = 1;
+  return 0;
+}
+
+/* Enables the search index with the given key prefix function, NULL
+   disables it and releases its memory. The index holds the key prefixes
+   of the sorted elements in Eytzinger (breadth first) order, so the
+   first levels of every search share a few cache lines and the keys
+   themselves are only read at the end. */
+void vector_set_index(vector* vec, vec_key_prefix_func prefix_func) {
+  if (!vec)
+    return;
+  vec->index_prefix = prefix_func;
+  vec->index_valid = 0;
+  if (!prefix_func) {
+    free(vec->index_keys);
+    free(vec->index_pos);
+    vec->index_keys = NULL;
+    vec->index_pos = NULL;
+    vec->index_cap = 0;
+  }
+}
+
+/* vector_binary_search through the index, which is rebuilt first if the
+   vector changed since the last build. Falls back to the plain search if
+   no index is set or it cannot be built. */
+void* vector_index_search(vector* vec, const void* key) {
+  if (!vec || !vec->index_prefix || (!vec->sorted && !vec->max_tail))
+    return vector_binary_search(vec, key);
+  size_t prefix = vec->sorted ? vec->size : vec->sorted_prefix;
+  if (!vec->index_valid || vec->index_n != prefix)
+    vector_build_index(vec, prefix);
+  return vector_binary_search(vec, key);
+}
+
 /* ---------- Iteration ---------- */
 
 void vector_iterate(const vector* vec,
@@ -247,3 +1286,19 @@ size_t vector_size(const vector* vec) {
 int vector_is_sorted(const vector* vec) {
   return vec ? vec->sorted : 0;
 }
+
+/* ---------- Statistics ---------- */
+
+/* Counters since vector_create; all zero unless built with
+   CONTAINER_STATS */
+vec_statistics vector_stats(const vector* vec) {
+  vec_statistics s;
+  memset(&s, 0, sizeof(s));
+#ifdef CONTAINER_STATS
+  if (vec)
+    s = vec->stats;
+#else
+  (void)vec; /* unused */
+#endif
+  return s;
+}
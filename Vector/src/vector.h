@@ -2,13 +2,50 @@
 #define VECTOR_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+/* Natural runs shorter than this are extended by insertion sort */
+#define VEC_MIN_RUN 32
+
+/* Elements per thread below which vector_sort_parallel uses fewer threads
+   (down to the sequential sort) */
+#define VEC_PARALLEL_MIN_CHUNK 16384
+
+/* With auto shrink on, deletions shrink the capacity once the size drops
+   below a VEC_SHRINK_RATIO-th of it */
+#define VEC_SHRINK_RATIO 4
+
+/* Below this many elements vector_sort_radix uses the merge sort */
+#define VEC_RADIX_CUTOFF 64
+
+/* Bits per pass of the integer radix sort: 11 sorts 64 bit prefixes in
+   six passes with 16 KB histograms */
+#define VEC_RADIX_BITS 11
+
+/* Alignment of the search index, so the slots three levels below any
+   index slot share one cache line */
+#define VEC_INDEX_ALIGN 64
 
 /* Comparison function for keys */
 typedef int (*vec_key_cmp_func)(const void* a, const void* b);
 
+/* Key prefix for the search index and inline prefixes. Must keep the key
+   order: if a sorts before or equal to b, prefix(a) <= prefix(b). Equal
+   prefixes are told apart by the comparison function. */
+typedef uint64_t (*vec_key_prefix_func)(const void* key);
+
+/* Keys vector_sort_radix sorts by */
+typedef enum {
+  VEC_RADIX_PREFIX, /* inline prefixes, see vector_set_inline_prefix */
+  VEC_RADIX_STRING  /* NUL terminated byte strings, in strcmp order */
+} vec_radix_kind;
+
 /* Free function for elements */
 typedef void (*vec_free_func)(void* key, void* value);
 
+/* Predicate for vector_delete_if, nonzero deletes the element */
+typedef int (*vec_pred_func)(void* key, void* value, void* user_data);
+
 /* Iteration callback */
 typedef void (*vec_iter_func)(size_t index,
                               void* key,
@@ -20,13 +57,45 @@ typedef struct {
   void* value;
 } vect_elem;
 
+/* Counters kept when built with CONTAINER_STATS (see vector_stats).
+   bytes_moved covers every memmove, in sorts and in insertions and
+   deletions. */
+typedef struct {
+  size_t sorts;     /* sorts of two or more elements, all kinds */
+  size_t sort_cmps; /* element comparisons made by them */
+  size_t bytes_moved;
+} vec_statistics;
+
 typedef struct {
   vect_elem* data;
   size_t size;
   size_t capacity;
   int sorted;
+  size_t sorted_prefix; /* data[0, sorted_prefix) is in order */
+  size_t max_tail;      /* buffered mode: longest unsorted tail, 0 = off */
+  int auto_shrink;      /* deletions give back memory */
   vec_key_cmp_func cmp_func;
   vec_free_func free_func;
+  vec_key_prefix_func inline_prefix; /* compared before cmp_func */
+  uint64_t* prefixes; /* inline prefixes parallel to data, capacity entries;
+                         NULL unless inline_prefix is set */
+  int prefix_exact;   /* equal prefixes mean equal keys */
+  /* Sort buffers, kept across sorts */
+  vect_elem* scratch;
+  uint64_t* scratch_prefixes; /* with inline prefixes only */
+  size_t scratch_cap;
+  size_t* runs;
+  size_t runs_cap;
+  /* Search index over the sorted prefix, rebuilt lazily */
+  vec_key_prefix_func index_prefix;
+  uint64_t* index_keys; /* key prefixes in Eytzinger order, from slot 1 */
+  size_t* index_pos;    /* position in data of each slot */
+  size_t index_n;       /* elements covered */
+  size_t index_cap;
+  int index_valid;
+#ifdef CONTAINER_STATS
+  vec_statistics stats;
+#endif
 } vector;
 
 /* Lifecycle */
@@ -38,18 +107,31 @@ void vector_destroy(vector* vec);
 
 /* Modification */
 int vector_push_back(vector* vec, void* key, void* value);
+int vector_insert_sorted(vector* vec, void* key, void* value);
+void vector_set_buffered(vector* vec, const size_t max_tail);
+void vector_set_inline_prefix(vector* vec,
+                              vec_key_prefix_func prefix_func,
+                              const int exact);
 int vector_insert_after(vector* vec,
                         const size_t index,
                         void* key,
                         void* value);
 int vector_delete(vector* vec, const size_t index);
+int vector_delete_range(vector* vec, const size_t from, const size_t to);
+size_t vector_delete_if(vector* vec, vec_pred_func pred, void* user_data);
+int vector_shrink_to_fit(vector* vec);
+void vector_set_auto_shrink(vector* vec, const int on);
 
 /* Access */
 vect_elem* vector_get(vector* vec, const size_t index);
 
 /* Sorting & searching */
 void vector_sort_stable(vector* vec);
+void vector_sort_parallel(vector* vec, const size_t threads);
+int vector_sort_radix(vector* vec, const vec_radix_kind kind);
 void* vector_binary_search(const vector* vec, const void* key);
+void vector_set_index(vector* vec, vec_key_prefix_func prefix_func);
+void* vector_index_search(vector* vec, const void* key);
 
 /* Iteration unsorted */
 void vector_iterate(const vector* vec,
@@ -75,4 +157,7 @@ void vector_iterate_sorted_reverse(vector* vec,
 size_t vector_size(const vector* vec);
 int vector_is_sorted(const vector* vec);
 
+/* Statistics */
+vec_statistics vector_stats(const vector* vec);
+
 #endif
@@ -0,0 +1,120 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "suite.h"
+#include "vector.h"
+
+const char* const suite_container = "vector";
+const char* const suite_dict_path = "data/handedict.txt";
+
+static vector* create(const size_t n) {
+  vector* vec = vector_create(n ? n : 1, suite_str_cmp, NULL);
+  if (!vec) {
+    fprintf(stderr, "Failed to create vector\n");
+    abort();
+  }
+  return vec;
+}
+
+/* Values are the original positions */
+static void fill(vector* vec, char** keys, const size_t n) {
+  vector_clear(vec);
+  for (size_t i = 0; i < n; i++)
+    vector_push_back(vec, keys[i], (void*)(uintptr_t)i);
+}
+
+static void count_elem(size_t index, void* key, void* data, void* user_data) {
+  (void)index; /* unused */
+  (void)key;   /* unused */
+  (void)data;  /* unused */
+  (*(size_t*)user_data)++;
+}
+
+/* Every other element by original position */
+static int odd_position(void* key, void* value, void* user_data) {
+  (void)key;       /* unused */
+  (void)user_data; /* unused */
+  return (uintptr_t)value & 1;
+}
+
+static void run_insert(const suite_keys* k, char** keys, const char* name) {
+  if (!suite_enabled(name))
+    return;
+  vector* vec = create(0);
+  suite_begin();
+  for (size_t i = 0; i < k->n; i++)
+    vector_push_back(vec, keys[i], keys[i]);
+  suite_end(k, name, k->n);
+  vector_destroy(vec);
+}
+
+/* Example 2: every line pushed back in file order, left unsorted */
+void* suite_fill_dict(ChineseDictEntry* entries, const size_t n) {
+  vector* vec = create(0);
+  for (size_t i = 0; i < n; i++)
+    vector_push_back(vec, entries[i].trad, &entries[i]);
+  return vec;
+}
+
+void suite_free_dict(void* container) {
+  vector_destroy(container);
+}
+
+/* Inserts are push_backs into a vector that starts small; lookups are
+   binary searches on the sorted vector, through the keys backwards. The
+   remove workload is one vector_delete_if pass dropping every other
+   element, counted per element visited. */
+void suite_run(const suite_keys* k) {
+  size_t n = k->n;
+  run_insert(k, k->random, "insert_random");
+  run_insert(k, k->sorted, "insert_sequential");
+
+  vector* vec = create(n);
+  fill(vec, k->random, n);
+  if (suite_enabled("sort")) {
+    suite_begin();
+    vector_sort_stable(vec);
+    suite_end(k, "sort", n);
+  } else {
+    vector_sort_stable(vec);
+  }
+
+  if (suite_enabled("get_hit")) {
+    size_t found = 0;
+    suite_begin();
+    for (size_t i = n; i-- > 0;)
+      found += vector_binary_search(vec, k->random[i]) != NULL;
+    suite_end(k, "get_hit", n);
+    /* The value of the key first inserted is position 0, so NULL */
+    if (found + 1 < n)
+      fprintf(stderr, "get_hit: %zu of %zu found\n", found, n);
+  }
+
+  if (suite_enabled("get_miss")) {
+    size_t found = 0;
+    suite_begin();
+    for (size_t i = n; i-- > 0;)
+      found += vector_binary_search(vec, k->misses[i]) != NULL;
+    suite_end(k, "get_miss", n);
+    if (found != 0)
+      fprintf(stderr, "get_miss: %zu found\n", found);
+  }
+
+  if (suite_enabled("iterate")) {
+    size_t count = 0;
+    suite_begin();
+    vector_iterate(vec, count_elem, 0, &count);
+    suite_end(k, "iterate", count);
+  }
+
+  if (suite_enabled("remove")) {
+    suite_begin();
+    vector_delete_if(vec, odd_position, NULL);
+    suite_end(k, "remove", n);
+    if (vector_size(vec) != (n + 1) / 2)
+      fprintf(stderr, "remove: %zu elements left\n", vector_size(vec));
+  }
+
+  vector_destroy(vec);
+}